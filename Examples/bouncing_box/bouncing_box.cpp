@@ -10,7 +10,7 @@ int main() {
     LibTesix::Style background("background");
     background.BG(LibTesix::Color(0, 50, 0));
 
-    const LibTesix::Style* background_p = LibTesix::style_allocator.Add(background);
+    LibTesix::StyleId background_id = LibTesix::style_allocator.Add(background);
 
     printf("sus\n");
 
@@ -18,17 +18,20 @@ int main() {
 
     printf("sus\n");
 
-    LibTesix::Window win(json, "window");
+    LibTesix::Scene scene;
+    scene.SetBackground(background_id);
+
+    LibTesix::Window& win = scene.GetWindow(scene.AddWindow(LibTesix::Window(json, "window")));
 
     printf("sus\n");
-    LibTesix::Clear(background_p);
 
     int64_t x_vel = 2;
     int64_t y_vel = 1;
 
     while(true) {
-        win.Draw(LibTesix::state);
-        LibTesix::Update();
+        // Only the cells the box moved onto or off of are drawn again
+        scene.Draw(LibTesix::state);
+        LibTesix::output.Flush();
 
         if(win.GetX() + 1 >= LibTesix::GetTerminalWidth() - win.GetWidth() || win.GetX() <= 0) {
             x_vel = -x_vel;
@@ -41,7 +44,6 @@ int main() {
         win.Move(win.GetX() + x_vel, win.GetY() + y_vel);
 
         std::this_thread::sleep_for(std::chrono::milliseconds(20));
-        LibTesix::Clear(background_p);
     }
 
     return 0;
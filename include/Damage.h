@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cinttypes>
+#include <utility>
+#include <vector>
+
+namespace LibTesix {
+
+// A rectangle of terminal cells, x and y can be negative for areas that are partly off the terminal
+struct Rect {
+    int64_t x;
+    int64_t y;
+    uint64_t width;
+    uint64_t height;
+};
+
+// A run of columns of a single line, from first to second (exclusive)
+typedef std::pair<int64_t, int64_t> Span;
+
+// Adds the columns from start to end to spans, which are kept sorted and merged with the ones they touch
+void AddSpan(std::vector<Span>& spans, int64_t start, int64_t end);
+
+// The cells of the terminal that changed during a frame, stored as the damaged spans of every line
+class DamageRegion {
+  public:
+    DamageRegion();
+
+  public:
+    // Parts of rect outside of the region are ignored
+    void Add(const Rect& rect);
+    // Damages every cell
+    void AddAll();
+
+    // Makes the region cover width * height cells, everything is damaged afterwards
+    void Resize(uint64_t width, uint64_t height);
+    void Clear();
+
+    // The damaged spans of line, sorted and not touching each other
+    const std::vector<Span>& Line(uint64_t line) const;
+
+    uint64_t GetWidth() const;
+    uint64_t GetHeight() const;
+
+  private:
+    std::vector<std::vector<Span>> lines;
+
+    uint64_t width = 0;
+};
+
+} // namespace LibTesix
@@ -1,9 +1,15 @@
 #pragma once
 
 #include "Json.h"
+#include "Output.h"
 #include "Overlay.h"
+#include "Scene.h"
+#include "Screen.h"
 #include "SegmentArray.h"
 #include "Style.h"
+#include "StyledRope.h"
 #include "StyledString.h"
+#include "StyledStringView.h"
 #include "Terminal.h"
+#include "Unicode.h"
 #include "Window.h"
\ No newline at end of file
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cinttypes>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <vector>
+
+namespace LibTesix {
+
+// Collects the bytes of a whole frame and writes them to a file descriptor with a single write
+// Bytes can also be referenced instead of copied, the frame is then written with writev straight from where they are stored
+// The buffer keeps its capacity between frames
+class OutputBuffer {
+  public:
+    OutputBuffer(int fd = STDOUT_FILENO);
+
+    // Whoever referenced bytes only holds a handle to the buffer, copying the buffer would leave the handle pointing at the original
+    OutputBuffer(const OutputBuffer&) = delete;
+    OutputBuffer& operator=(const OutputBuffer&) = delete;
+
+  public:
+    void Append(const char* data, uint64_t len);
+    void Append(std::string_view str);
+    void Append(char c);
+    // Appends c count times
+    void Append(uint64_t count, char c);
+    void AppendNumber(uint64_t num);
+    // Adds str without copying it, it has to stay valid and unchanged until the next Flush or Clear
+    // Whoever owns str and wants to change it earlier calls CopyReferences through the handle, the buffer itself can be destroyed at any time
+    void AppendRef(std::string_view str);
+
+    // Appends the escape code to move the cursor to col, line (starting at 0)
+    void MoveCursor(uint64_t col, uint64_t line);
+
+    // Writes all collected bytes to the file descriptor and empties the buffer
+    // Returns false if the bytes couldn't be written
+    bool Flush();
+
+    // Discards all collected bytes
+    void Clear();
+
+    // Copies all referenced bytes into the buffer, after this what they were referenced from can change
+    void CopyReferences();
+    // Counts the frames that were flushed or cleared, bytes referenced during a frame are released once it changes
+    uint64_t Frame() const;
+
+    // Expires once the buffer is destroyed, so it can be held by whoever referenced bytes without keeping the buffer alive
+    std::weak_ptr<OutputBuffer*> Handle() const;
+
+    void SetFd(int fd);
+    int GetFd() const;
+
+    // The collected bytes, referenced bytes are copied into the buffer first
+    const char* Data();
+    uint64_t Size() const;
+
+  private:
+    // A run of bytes in the frame, either referenced or stored in buffer at offset if data is nullptr
+    struct Piece {
+        const char* data;
+        uint64_t offset;
+        uint64_t len;
+    };
+
+    // Adds len bytes that were just appended to buffer
+    void AddBuffered(uint64_t len);
+    // Writes all pieces with writev, IOV_MAX pieces at a time
+    bool FlushPieces();
+
+  private:
+    std::string buffer;
+    // Reused by CopyReferences
+    std::string flat;
+    int fd;
+
+    // Empty as long as nothing was referenced, the frame is then just buffer
+    std::vector<Piece> pieces;
+    uint64_t referenced = 0;
+
+    uint64_t frame = 0;
+
+    std::vector<iovec> iov;
+
+    std::shared_ptr<OutputBuffer*> handle;
+};
+
+// The sink used for stdout
+inline OutputBuffer output;
+
+} // namespace LibTesix
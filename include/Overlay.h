@@ -16,11 +16,11 @@ struct Overlay {
 
     void Clear();
 
-    void Box(uint64_t x, uint64_t y, uint64_t width, uint64_t height, const Style* style, const char* right = "┃", const char* left = "┃",
+    void Box(uint64_t x, uint64_t y, uint64_t width, uint64_t height, StyleId style, const char* right = "┃", const char* left = "┃",
         const char* top = "━", const char* bottom = "━", const char* top_right = "┏", const char* top_left = "┓", const char* bottom_right = "┗",
         const char* bottom_left = "┛");
 
-    void Box(const Style* style, const char* right = "┃", const char* left = "┃", const char* top = "━", const char* bottom = "━",
+    void Box(StyleId style, const char* right = "┃", const char* left = "┃", const char* top = "━", const char* bottom = "━",
         const char* top_right = "┏", const char* top_left = "┓", const char* bottom_right = "┗", const char* bottom_left = "┛");
 
     std::vector<StyledSegmentArray> lines;
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "Damage.h"
+#include "Output.h"
+#include "Style.h"
+#include "Window.h"
+
+#include <cinttypes>
+#include <memory>
+#include <vector>
+
+namespace LibTesix {
+
+// A set of windows stacked by their z, windows with the same z are stacked in the order they were added
+// Windows are opaque, so Draw only serializes the parts of each window that aren't covered by a window above it
+// Only what changed since the last Draw is drawn again, the parts of the terminal no window covers are filled with the background
+class Scene {
+  public:
+    Scene();
+
+  public:
+    // Returns the id of the added window
+    uint64_t AddWindow(const Window& window, int64_t z = 0);
+    void RemoveWindow(uint64_t id);
+    // The returned window is valid until it is removed
+    Window& GetWindow(uint64_t id);
+    void SetZ(uint64_t id, int64_t z);
+
+    // The style of the cells no window covers
+    void SetBackground(StyleId style);
+
+    // Draws the visible parts of every window that were damaged since the last Draw, expects the terminal to still show that Draw
+    // Calls the resize callbacks first if the terminal was resized
+    void Draw(StyleId& state, OutputBuffer& out = output);
+    // Draws everything on the next Draw
+    void Invalidate();
+
+  private:
+    struct Entry {
+        uint64_t id;
+        int64_t z;
+
+        std::unique_ptr<Window> window;
+    };
+
+    // Returns the entry with the given id, throws if there is none
+    Entry& FindEntry(uint64_t id, const char* caller);
+    void SortWindows();
+
+    // Sets visible to the parts of the columns from start to end that aren't in covered, and adds them to covered
+    static void Uncover(std::vector<Span>& covered, int64_t start, int64_t end, std::vector<Span>& visible);
+    // Sets damaged to the parts of the spans in visible that are in damage
+    static void Intersect(const std::vector<Span>& visible, const std::vector<Span>& damage, std::vector<Span>& damaged);
+
+  private:
+    // Sorted by z from the bottom to the top
+    std::vector<Entry> windows;
+    uint64_t next_id = 0;
+
+    // The columns of every terminal line covered by the windows drawn so far, kept between frames so drawing doesn't allocate
+    std::vector<std::vector<Span>> covered;
+    std::vector<Span> visible;
+    std::vector<Span> damaged;
+
+    // What changed since the last Draw, collected from the windows at the start of Draw
+    DamageRegion damage;
+
+    StyleId background = STANDARD_STYLE;
+    // The style generation of the last Draw, everything is drawn again once a style changed
+    uint64_t style_generation = 0;
+};
+
+} // namespace LibTesix
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "Output.h"
+#include "SegmentArray.h"
+#include "Style.h"
+
+#include <cinttypes>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace LibTesix {
+
+// A single character cell of the terminal
+struct Cell {
+    Cell();
+    Cell(UChar32 glyph, StyleId style);
+    // glyph holds the UTF-8 bytes of a grapheme cluster, clusters that don't fit are cut after their first character
+    Cell(std::string_view glyph, StyleId style);
+
+    bool operator==(const Cell& other) const;
+
+    // The UTF-8 encoded grapheme cluster displayed in this cell
+    // a len of 0 marks the cell as covered by the wide glyph to its left
+    char glyph[16];
+    uint8_t len;
+
+    StyleId style;
+};
+
+// A grid of cells, stored line by line
+struct CellBuffer {
+    CellBuffer();
+    CellBuffer(uint64_t width, uint64_t height);
+
+    // Resizes the buffer while keeping the cells that are still inside of it
+    void Resize(uint64_t width, uint64_t height);
+    void Fill(const Cell& cell);
+
+    Cell& At(uint64_t col, uint64_t line);
+    const Cell& At(uint64_t col, uint64_t line) const;
+
+    std::vector<Cell> cells;
+
+    uint64_t width;
+    uint64_t height;
+};
+
+// A front and back buffer of the whole terminal
+// Everything is drawn into the back buffer, Flush then only emits the cells that differ from the front buffer, which holds what is
+// currently displayed on the terminal
+class Screen {
+  public:
+    // Creates a screen that follows the size of the terminal
+    Screen();
+    Screen(uint64_t width, uint64_t height);
+
+  public:
+    // Writes str into the back buffer at x, y. Anything outside of the screen or past max_len is clipped
+    void Write(int64_t x, int64_t y, const StyledSegmentArray& str, uint64_t max_len = UINT64_MAX);
+
+    void Clear(StyleId style);
+
+    // Emits every changed cell and makes the back buffer the new front buffer
+    void Flush(StyleId& state, OutputBuffer& out = output);
+
+    // Forces the next Flush to redraw every cell
+    void Invalidate();
+
+    void Resize(uint64_t width, uint64_t height);
+
+    uint64_t GetWidth();
+    uint64_t GetHeight();
+
+  private:
+    // Sets the cell at col, line in the back buffer, cells that are left over from overwritten wide glyphs are turned into spaces
+    void SetCell(uint64_t col, uint64_t line, const Cell& cell, uint64_t cell_width);
+
+    CellBuffer front;
+    CellBuffer back;
+
+    // Set if the screen is resized together with the terminal
+    bool fit_terminal = false;
+    // The style generation of the last Flush, every cell is drawn again once a style changed
+    uint64_t style_generation = 0;
+};
+
+} // namespace LibTesix
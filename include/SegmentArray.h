@@ -2,54 +2,275 @@
 
 #include "Style.h"
 
+#include <algorithm>
 #include <cinttypes>
+#include <span>
+#include <string>
+#include <string_view>
 #include <unicode/unistr.h>
+#include <vector>
 
 namespace LibTesix {
 
+struct StyledSegment;
+
+// A non-owning view of the text of a segment, either of a StyledSegment or of a segment inside of a StyledSegmentArray
+// The view is invalidated by any change to what it was taken from
+struct StyledSegmentView {
+    std::string_view str;
+    // Byte offset of the cluster covering each column, empty if the text is ASCII
+    std::span<const uint32_t> offsets;
+
+    StyleId style;
+
+    // Copies len columns starting at index
+    StyledSegment Slice(uint64_t index = 0, uint64_t len = UINT64_MAX) const;
+    // Copies len columns starting at index into slice, whose storage is reused
+    void SliceTo(StyledSegment& slice, uint64_t index = 0, uint64_t len = UINT64_MAX) const;
+    // Appends the UTF-8 bytes of len columns starting at index to out
+    void AppendTo(std::string& out, uint64_t index = 0, uint64_t len = UINT64_MAX) const;
+    std::string_view Str() const;
+
+    uint64_t Len() const;
+    // Byte offset of the cluster covering the column at index, Len() maps to the end of the string
+    uint64_t Offset(uint64_t index) const;
+    // Whether the column at index is covered by the wide cluster to its left
+    bool IsContinuation(uint64_t index) const;
+    // The first column after the cluster covering index
+    uint64_t NextCluster(uint64_t index) const;
+
+  private:
+    // Clamps the columns from index to index + len to the segment and moves them onto whole clusters, lead and trail are the columns of
+    // cut wide clusters that are replaced by spaces
+    void Clip(uint64_t& index, uint64_t len, uint64_t& end, uint64_t& lead, uint64_t& trail) const;
+};
+
+// Text in a single style, stored as UTF-8 so it can be copied to the terminal as is
+// Indices count terminal columns, for text that isn't pure ASCII a side index holds the byte offset of the grapheme cluster covering each
+// column. A wide cluster covers two columns, cutting it in half leaves a space in its place
 struct StyledSegment {
-    StyledSegment(const icu::UnicodeString& str, const Style* style, uint64_t start = 0);
-    StyledSegment(const char* str, const Style* style, uint64_t start);
+    StyledSegment(std::string_view str, StyleId style);
+    StyledSegment(const icu::UnicodeString& str, StyleId style);
+    StyledSegment(const char* str, StyleId style);
     StyledSegment();
-    icu::UnicodeString str;
 
-    const Style* style;
-    uint64_t start;
+    StyleId style;
+
+    // Replaces the text and style of the segment, its storage is reused
+    void Assign(std::string_view str, StyleId style);
 
+    // Removes everything from index on and returns it as a new segment
     StyledSegment Split(uint64_t index);
+    void Remove(uint64_t index, uint64_t len);
+    void Append(std::string_view str);
+    void Append(const StyledSegmentView& segment);
+
+    StyledSegment Slice(uint64_t index, uint64_t len = UINT64_MAX) const;
+    void AppendTo(std::string& out, uint64_t index, uint64_t len = UINT64_MAX) const;
+    std::string_view Str() const;
+
     uint64_t Len() const;
+    uint64_t Offset(uint64_t index) const;
+    bool IsContinuation(uint64_t index) const;
+    uint64_t NextCluster(uint64_t index) const;
+
+    StyledSegmentView View() const;
+    operator StyledSegmentView() const;
+
+  private:
+    // Indexes the clusters from byte from on
+    void Index(uint64_t from);
+
+    std::string str;
+    // Byte offset of the cluster covering each column, empty as long as the text is ASCII
+    std::vector<uint32_t> offsets;
+
+    friend struct StyledSegmentView;
 };
 
-struct StyledSegmentArray {
+// The columns from start to end (inclusive) in the given style
+struct StyleRange {
+    uint64_t start;
+    uint64_t end;
+    StyleId style;
+};
+
+// Positions of which all from some index on move by the same amount after an edit, like the starts of the segments behind it
+// Instead of adding the delta to every following value, the values from shift_index on are stored without the pending shift, which is only
+// applied to the values between two consecutive shifts
+// Inserting or erasing a value still moves every value behind it in the vector, so those edits stay O(n), just with a cheap memmove
+template<class T> class ShiftedArray {
   public:
-    StyledSegmentArray();
+    T operator[](uint64_t index) const {
+        return values[index] + (index >= shift_index ? shift : 0);
+    }
+
+    void Set(uint64_t index, T value) {
+        values[index] = value - (index >= shift_index ? shift : 0);
+    }
+
+    // Moves every value from index on by delta
+    void Shift(uint64_t index, int64_t delta) {
+        if(index >= shift_index) {
+            for(uint64_t i = shift_index; i < index; i++) {
+                values[i] += shift;
+            }
+        } else {
+            for(uint64_t i = index; i < shift_index; i++) {
+                values[i] -= shift;
+            }
+        }
+
+        shift_index = index;
+        shift += delta;
+    }
+
+    void Insert(uint64_t index, T value) {
+        if(index < shift_index) {
+            values.insert(values.begin() + index, value);
+            shift_index++;
+        } else {
+            values.insert(values.begin() + index, value - shift);
+        }
+    }
+
+    void Erase(uint64_t index, uint64_t count) {
+        values.erase(values.begin() + index, values.begin() + index + count);
+
+        // Only the erased values in front of shift_index move it back, subtracting count first could wrap around
+        if(shift_index > index) shift_index = std::max(shift_index, index + count) - count;
+    }
+
+    void PushBack(T value) {
+        Insert(values.size(), value);
+    }
+
+    // Replaces the values with values that don't have a pending shift
+    void Assign(std::vector<T> values) {
+        this->values = std::move(values);
+
+        shift_index = 0;
+        shift = 0;
+    }
+
+    // Removes every value but keeps the storage
+    void Clear() {
+        values.clear();
+
+        shift_index = 0;
+        shift = 0;
+    }
+
+    void Reserve(uint64_t size) {
+        values.reserve(size);
+    }
+
+    uint64_t Size() const {
+        return values.size();
+    }
+
+  private:
+    std::vector<T> values;
+
+    uint64_t shift_index = 0;
+    int64_t shift = 0;
+};
+
+// Segments sorted by their start column, there can be gaps between them
+// The segments are stored as a struct of arrays: their starts and styles are kept in dense arrays and the text of all segments is
+// stored back to back in a single buffer
+struct StyledSegmentArray {
+    friend struct StyledStringView;
 
   public:
-    std::vector<StyledSegment> segments;
+    StyledSegmentArray();
 
   public:
-    void Append(const icu::UnicodeString& str, const Style* style);
-    void Append(const char* str, const Style* style);
+    void Append(const StyledSegmentView& segment);
+    void Append(const icu::UnicodeString& str, StyleId style);
+    void Append(std::string_view str, StyleId style);
+    void Append(const char* str, StyleId style);
 
-    void Add(const icu::UnicodeString& str, const Style* style, uint64_t index);
-    void Add(const char* str, const Style* style, uint64_t index);
+    void Add(const StyledSegmentView& segment, uint64_t index);
+    void Add(const icu::UnicodeString& str, StyleId style, uint64_t index);
+    void Add(std::string_view str, StyleId style, uint64_t index);
+    void Add(const char* str, StyleId style, uint64_t index);
 
     void Erase(uint64_t start, uint64_t end);
 
+    // Changes the style of the text in every range without touching the text itself, the ranges have to be sorted and mustn't overlap
+    // A wide cluster cut by the end of a range is restyled as a whole with the style of its first column
+    void Restyle(std::span<const StyleRange> ranges);
+
     void Clear();
 
+    // Merges every run of touching segments with the same style into one segment
+    void Compact();
+
     uint64_t Len() const;
 
+    uint64_t SegmentCount() const;
+    // The segment at segment_index, only valid until the array is changed
+    StyledSegmentView Segment(uint64_t segment_index) const;
+    StyleId SegmentStyle(uint64_t segment_index) const;
+
+    // The index of the first character of a segment
+    uint64_t Start(uint64_t segment_index) const;
+
     void PrintDebug() const;
 
   protected:
+    // Returns the index of the last segment starting at or before index, O(log n)
     uint64_t GetSegmentIndex(uint64_t index) const;
-    void InsertSegment(StyledSegment segment, uint64_t index);
+    // Returns the index of the first segment starting after index, O(log n)
+    uint64_t UpperBound(uint64_t index) const;
+
+    // The segments passed to these mustn't be views into this array, they would be invalidated while they are copied
+    void InsertSegment(const StyledSegmentView& segment, uint64_t start, uint64_t index);
+    void ReplaceSegment(uint64_t index, const StyledSegmentView& segment);
+    void EraseSegment(uint64_t index, uint64_t count = 1);
+    // Appends the text of segment to the last segment
+    void AppendToLast(const StyledSegmentView& segment);
+    // Splits the segment in two at the column index, the text stays in place unless a wide cluster is cut
+    void SplitSegment(uint64_t segment_index, uint64_t index);
+
+    // Merges the segment with its neighbours if they touch it and share its style, returns the new index of the segment
+    uint64_t Coalesce(uint64_t segment_index);
+    // Whether the segment and the one after it touch and share their style
+    bool Touching(uint64_t segment_index) const;
+
+    void SetStart(uint64_t segment_index, uint64_t start);
+    // Moves the start of every segment from segment_index on by delta
+    void Shift(uint64_t segment_index, int64_t delta);
 
   private:
     bool InSegment(uint64_t segment_index, uint64_t index) const;
     bool Clean(uint64_t index);
     bool HitsSegment(uint64_t start, uint64_t end) const;
+
+    uint64_t SegmentLen(uint64_t segment_index) const;
+    // Whether segment points into the text of this array
+    bool Views(const StyledSegmentView& segment) const;
+
+    // Replaces the text of count segments from index on with the text of segment, or removes it if segment is nullptr
+    void SpliceText(uint64_t index, uint64_t count, const StyledSegmentView* segment);
+    // Merges the text of the segment after segment_index into it, the text itself doesn't move
+    void MergeNext(uint64_t segment_index);
+
+    // The starts of all segments
+    ShiftedArray<uint64_t> starts;
+
+    std::vector<StyleId> styles;
+
+    // The text of all segments back to back
+    std::string text;
+    // The cluster offsets of all segments that aren't ASCII, relative to the start of their segment
+    std::vector<uint32_t> column_offsets;
+
+    // Where the text and cluster offsets of each segment start, with one more entry for the end of the last segment
+    // Like the starts they are shifted lazily, so changing the text of a segment doesn't rewrite the entries of every segment after it
+    ShiftedArray<uint32_t> byte_starts;
+    ShiftedArray<uint32_t> column_starts;
 };
 
-} // namespace LibTesix
\ No newline at end of file
+} // namespace LibTesix
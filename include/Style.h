@@ -3,23 +3,41 @@
 #include <bitset>
 #include <cinttypes>
 #include <cstring>
+#include <deque>
 #include <map>
 #include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
 
 namespace LibTesix {
 
 struct Color {
-    Color(uint64_t r, uint64_t g, uint64_t b);
+    Color(uint8_t r, uint8_t g, uint8_t b);
     Color();
 
     bool operator==(const Color& other) const;
 
-    uint64_t r;
-    uint64_t g;
-    uint64_t b;
+    uint8_t R() const;
+    uint8_t G() const;
+    uint8_t B() const;
+
+    // Unset colors use the default color of the terminal
+    bool IsSet() const;
+
+    static constexpr uint32_t UNSET = UINT32_MAX;
+
+    // The color packed as 0x00RRGGBB or UNSET
+    uint32_t rgb;
 };
 
+const Color UNSET_COLOR = [] {
+    Color color;
+    color.rgb = Color::UNSET;
+    return color;
+}();
+
 const Color STANDARD_FG(255, 255, 255);
 const Color STANDARD_BG(0, 0, 0);
 
@@ -35,6 +53,15 @@ struct ColorPair {
 
 const ColorPair STANDARD_COLORPAIR(STANDARD_FG, STANDARD_BG);
 
+// Refers to a style in LibTesix::style_allocator
+// The lower bits are the index of the style, the upper bits count how often the index was reused by an interned style. An id of a freed
+// style therefore never refers to the style that replaced it
+typedef uint32_t StyleId;
+
+const StyleId STANDARD_STYLE = 0;
+// Refers to no style, used as terminal state when the style of the terminal isn't known
+const StyleId NO_STYLE = UINT32_MAX;
+
 struct Style {
     friend class StyleAllocator;
 
@@ -59,6 +86,8 @@ struct Style {
 
     // Returns the escape code sequence used in order to change from the supplied teminal state to this style
     std::string GetEscapeCode(const Style& state) const;
+    // Returns the escape code sequence used to change from an unknown terminal state to this style
+    std::string GetEscapeCode() const;
 
     void Reset();
 
@@ -78,17 +107,88 @@ class StyleAllocator {
   public:
     StyleAllocator();
 
+    // The returned pointers stay valid, the style they point to changes if it is replaced by Set or its index is reused by Intern
+    // Ids of freed styles return nullptr
     const Style* operator[](const std::string& name);
-    const Style* operator[](uint64_t id);
+    const Style* operator[](StyleId id);
 
-    const Style* Add(const Style& style);
+    // Returns the id of the style with the given name, NO_STYLE if there is none
+    StyleId Id(const std::string& name);
+
+    StyleId Add(const Style& style);
+    // Replaces the style with the same name, adds it if there is none
+    // Replacing a style starts a new generation, so everything serialized with its old escape codes is serialized again
+    StyleId Set(const Style& style);
+
+    // Returns the id of an anonymous style that looks like style, adding one if there is none
+    // Interned styles are reference counted, every call has to be matched by a call to Release
+    // Storing an id in a string, window or overlay does NOT retain it, the caller has to keep a reference for as long as any text uses it
+    StyleId Intern(const Style& style);
+    void Retain(StyleId id);
+    // Frees an interned style once it isn't referenced anymore, its index is then reused by the next interned style under a new id
+    // Text that still uses the freed id isn't drawn in any style, it keeps the style the terminal is in
+    void Release(StyleId id);
+
+    // Returns the escape code to change the terminal from the style from to the style to
+    // from may be NO_STYLE or the id of a freed style, which is still held as terminal state, the terminal is then reset to to
+    // Codes are cached, the returned view is valid until the allocator is used again
+    std::string_view Transition(StyleId from, StyleId to);
+
+    // Changes whenever an existing id starts to look different, escape codes cached in an older generation are stale
+    uint64_t Generation() const;
 
   private:
-    std::map<std::string, uint64_t> ids;
-    std::vector<std::unique_ptr<const Style>> styles;
+    // Everything that makes up the look of a style
+    struct StyleKey {
+        StyleKey(const Style& style);
+
+        bool operator==(const StyleKey& other) const;
+
+        uint32_t fg;
+        uint32_t bg;
+        uint64_t modifiers;
+    };
+
+    struct StyleKeyHash {
+        uint64_t operator()(const StyleKey& key) const;
+    };
+
+    // Drops every cached code from or to the style with the given id
+    void ClearTransitions(StyleId id);
+
+    static constexpr uint32_t INDEX_BITS = 20;
+    static constexpr uint32_t INDEX_MASK = (1 << INDEX_BITS) - 1;
+    static constexpr uint32_t VERSION_MASK = UINT32_MAX >> INDEX_BITS;
+
+    static uint32_t Index(StyleId id);
+    // Whether id refers to a style that is allocated, false for NO_STYLE and ids of freed styles
+    bool Valid(StyleId id) const;
+
+  private:
+    std::map<std::string, StyleId> ids;
+    // A deque keeps the pointers returned by operator[] valid when styles are added
+    std::deque<Style> styles;
+
+    // The number of references to every interned style, named styles are never freed and have NAMED references
+    std::vector<uint64_t> references;
+    static constexpr uint64_t NAMED = UINT64_MAX;
+
+    // How often the index of every style was reused, named styles keep version 0 so their id is their index
+    std::vector<uint32_t> versions;
+
+    std::unordered_map<StyleKey, StyleId, StyleKeyHash> interned;
+    // Indices of freed interned styles
+    std::vector<uint32_t> free_indices;
+
+    // The escape codes between styles keyed by the id of from in the upper and of to in the lower 32 bits, from is NO_STYLE for the codes
+    // from an unknown terminal state
+    // Only the codes that are used are cached, the cache is emptied once it is full, so it doesn't grow with the square of the styles
+    std::unordered_map<uint64_t, std::string> transitions;
+    static constexpr uint64_t MAX_TRANSITIONS = 4096;
+
+    uint64_t generation = 0;
 };
 
 inline StyleAllocator style_allocator;
-inline const Style* STANDARD_STYLE = style_allocator["__default"];
 
 } // namespace LibTesix
\ No newline at end of file
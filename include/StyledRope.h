@@ -0,0 +1,85 @@
+#pragma once
+
+#include "Style.h"
+#include "StyledString.h"
+
+#include <cinttypes>
+#include <string>
+#include <string_view>
+#include <unicode/unistr.h>
+#include <utility>
+#include <vector>
+
+namespace LibTesix {
+
+// A styled string for large documents, stored as a balanced tree of styled pieces
+// Insert, Erase and Write are O(log n) in the number of pieces, Substr only visits the pieces inside of the range
+class StyledRope {
+  public:
+    StyledRope();
+    StyledRope(const icu::UnicodeString& base_string, StyleId style = STANDARD_STYLE);
+    StyledRope(std::string_view base_string, StyleId style = STANDARD_STYLE);
+    StyledRope(const char* base_string, StyleId style = STANDARD_STYLE);
+
+  public:
+    void Insert(const StyledSegment& segment, uint64_t index);
+    void Insert(const icu::UnicodeString& str, StyleId style, uint64_t index);
+    void Insert(std::string_view str, StyleId style, uint64_t index);
+    void Insert(const char* str, StyleId style, uint64_t index);
+    void Append(const StyledSegment& segment);
+    void Append(const icu::UnicodeString& str, StyleId style);
+    void Append(std::string_view str, StyleId style);
+    void Append(const char* str, StyleId style);
+    void Erase(uint64_t start, uint64_t end);
+    // Overwrites the characters from index on, returns the part that didn't fit
+    std::string Write(const StyledSegment& segment, uint64_t index);
+    std::string Write(const icu::UnicodeString& str, StyleId style, uint64_t index);
+    std::string Write(std::string_view str, StyleId style, uint64_t index);
+    std::string Write(const char* str, StyleId style, uint64_t index);
+
+    // Copies the characters from start to end (inclusive), e.g. the part of a document that is visible in a window
+    StyledString Substr(uint64_t start, uint64_t end) const;
+
+    void Clear();
+
+    uint64_t Len() const;
+
+  private:
+    static constexpr uint64_t NIL = UINT64_MAX;
+    // Longer strings are stored in multiple pieces so splitting a piece stays cheap
+    static constexpr uint64_t MAX_PIECE_LEN = 512;
+
+    struct Piece {
+        StyledSegment segment;
+
+        uint64_t left;
+        uint64_t right;
+
+        // Length of all pieces in this subtree
+        uint64_t len;
+        uint32_t priority;
+    };
+
+    uint64_t NewPiece(const StyledSegment& segment);
+    void FreeTree(uint64_t piece);
+    void Update(uint64_t piece);
+
+    uint64_t Merge(uint64_t left, uint64_t right);
+    // Splits the tree into the first index characters and the rest
+    std::pair<uint64_t, uint64_t> Split(uint64_t piece, uint64_t index);
+
+    // Builds a tree out of segment, split into pieces of at most MAX_PIECE_LEN
+    uint64_t Build(const StyledSegment& segment);
+
+    void Collect(uint64_t piece, uint64_t start, uint64_t end, StyledSegmentArray& substr) const;
+
+    uint64_t SubtreeLen(uint64_t piece) const;
+
+    std::vector<Piece> pieces;
+    std::vector<uint64_t> free_pieces;
+
+    uint64_t root = NIL;
+    uint32_t seed = 2463534242;
+};
+
+} // namespace LibTesix
@@ -1,19 +1,30 @@
 #pragma once
 
+#include "Output.h"
 #include "SegmentArray.h"
 #include "Style.h"
 
 #include <cinttypes>
+#include <span>
 #include <string>
+#include <string_view>
 #include <unicode/unistr.h>
 #include <vector>
 
 namespace LibTesix {
 
+// Text to be written at index, used to write many pieces of text into a string at once
+struct StyledSpan {
+    uint64_t index;
+    std::string_view str;
+    StyleId style;
+};
+
 struct StyledString : public StyledSegmentArray {
   public:
-    StyledString(const icu::UnicodeString& base_string, const Style* style = style_allocator[0UL]);
-    StyledString(const char* base_string, const Style* style = style_allocator[0UL]);
+    StyledString(const icu::UnicodeString& base_string, StyleId style = STANDARD_STYLE);
+    StyledString(std::string_view base_string, StyleId style = STANDARD_STYLE);
+    StyledString(const char* base_string, StyleId style = STANDARD_STYLE);
 
     StyledString(const StyledSegmentArray& string);
     StyledString(const std::vector<StyledSegment>& string);
@@ -22,13 +33,23 @@ struct StyledString : public StyledSegmentArray {
 
   public:
   public:
-    void Insert(const icu::UnicodeString& str, const Style* style, uint64_t index);
-    void Insert(const char* str, const Style* style, uint64_t index);
-    void Append(const icu::UnicodeString& str, const Style* style);
-    void Append(const char* str, const Style* style);
+    void Insert(const StyledSegment& segment, uint64_t index);
+    void Insert(const icu::UnicodeString& str, StyleId style, uint64_t index);
+    void Insert(std::string_view str, StyleId style, uint64_t index);
+    void Insert(const char* str, StyleId style, uint64_t index);
+    void Append(const StyledSegment& segment);
+    void Append(const icu::UnicodeString& str, StyleId style);
+    void Append(std::string_view str, StyleId style);
+    void Append(const char* str, StyleId style);
     void Erase(uint64_t start, uint64_t end);
-    icu::UnicodeString Write(const icu::UnicodeString& str, const Style* style, uint64_t index);
-    icu::UnicodeString Write(const char* str, const Style* style, uint64_t index);
+    // Overwrites the characters from index on, returns the part that didn't fit
+    std::string Write(const StyledSegmentView& segment, uint64_t index);
+    std::string Write(const icu::UnicodeString& str, StyleId style, uint64_t index);
+    std::string Write(std::string_view str, StyleId style, uint64_t index);
+    std::string Write(const char* str, StyleId style, uint64_t index);
+    // Overwrites the text of every span in a single pass over the string, text past the end of the string is cut off
+    // The spans have to be sorted by their index and mustn't overlap
+    void Write(std::span<const StyledSpan> spans);
 
     StyledString Substr(uint64_t start, uint64_t end);
 
@@ -36,22 +57,22 @@ struct StyledString : public StyledSegmentArray {
 
     using StyledSegmentArray::Len;
 
-    void Clear(const Style* style = style_allocator[0UL]);
-    void ClearStyle(const Style* style = style_allocator[0UL]);
+    void Clear(StyleId style = STANDARD_STYLE);
+    void ClearStyle(StyleId style = STANDARD_STYLE);
 
     void UpdateRaw();
-    std::string Raw(const Style& state, bool should_update = true);
+    std::string Raw(StyleId state, bool should_update = true);
 
-    const Style* StyleStart() const;
-    const Style* StyleEnd() const;
+    StyleId StyleStart() const;
+    StyleId StyleEnd() const;
 
-    void Print(Style& state, bool should_update = true);
+    void Print(StyleId& state, bool should_update = true, OutputBuffer& out = output);
     using StyledSegmentArray::PrintDebug;
 
   private:
     std::string raw;
-
-    void UpdateSegmentStart(uint64_t i = 0);
+    // The style generation raw was serialized in, raw is serialized again by Raw and Print once it is stale
+    uint64_t raw_generation = 0;
 };
 
 } // namespace LibTesix
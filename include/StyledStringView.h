@@ -0,0 +1,39 @@
+#pragma once
+
+#include "SegmentArray.h"
+#include "Style.h"
+#include "StyledString.h"
+
+#include <cinttypes>
+#include <span>
+#include <string>
+
+namespace LibTesix {
+
+// A non-owning view of the columns from start to end (exclusive) of a StyledString
+// The string has to outlive the view and mustn't be changed while the view is used
+struct StyledStringView {
+    StyledStringView(const StyledString& str, uint64_t start = 0, uint64_t end = UINT64_MAX);
+
+    uint64_t Len() const;
+
+    // Appends the text of the view to out as if the terminal was already in the style the view starts with
+    // The columns covered by overlay (using the columns of the string) are drawn on top of the view
+    // start_style and end_style are set to the styles the serialized text starts and ends with
+    void Serialize(std::string& out, StyleId& start_style, StyleId& end_style, const StyledSegmentArray* overlay = nullptr) const;
+    // Same as above with a stack of layers ordered from the bottom to the top, every column shows the topmost layer with a segment there
+    // The layers are composited in a single sweep over the columns of the view
+    void Serialize(std::string& out, StyleId& start_style, StyleId& end_style, std::span<const StyledSegmentArray* const> layers) const;
+
+    const StyledString* str;
+
+    uint64_t start;
+    uint64_t end;
+
+  private:
+    // Appends the columns from start to end of arr, start_style is set by the first appended segment
+    void SerializeRange(
+        const StyledSegmentArray& arr, uint64_t start, uint64_t end, std::string& out, StyleId& state, StyleId& start_style) const;
+};
+
+} // namespace LibTesix
@@ -1,7 +1,9 @@
 #pragma once
 
+#include "Output.h"
 #include "Style.h"
 
+#include <functional>
 #include <termios.h>
 
 // Overrides the size of the terminal to 211 colums and 41 lines
@@ -11,17 +13,30 @@ static const int STDIN = 0;
 
 namespace LibTesix {
 
-inline Style state("state", ColorPair(Color(-1, -1, -1), Color(-1, -1, -1)));
+// The style the terminal is currently in
+inline StyleId state = NO_STYLE;
 
 int InitScreen();
 
 void Interupt(int signal);
 void Exit();
+// Updates the cached terminal size on SIGWINCH
+void Resized(int signal);
 
-void Clear(const Style* style);
-void Update();
+void Clear(StyleId style, OutputBuffer& out = output);
+// Writes out everything drawn since the last update
+void Update(OutputBuffer& out = output);
 
+// The size of the terminal, cached since InitScreen and updated on every resize
 uint64_t GetTerminalWidth();
 uint64_t GetTerminalHeight();
 
+// Adds a function that is called with the new size once the terminal was resized, returns an id to remove it with
+uint64_t AddResizeCallback(std::function<void(uint64_t width, uint64_t height)> callback);
+void RemoveResizeCallback(uint64_t id);
+
+// Calls the resize callbacks if the terminal was resized since the last call, this is done by Update, Screen::Flush and Scene::Draw
+// Returns whether the terminal was resized
+bool HandleResize();
+
 } // namespace LibTesix
\ No newline at end of file
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cinttypes>
+#include <string_view>
+#include <vector>
+
+namespace LibTesix {
+
+// Returns the number of leading ASCII bytes of data
+uint64_t AsciiPrefix(const char* data, uint64_t len);
+
+// Returns the number of terminal cells the grapheme cluster takes up: 0 for marks that attach to the previous cluster, 2 for wide
+// characters and emoji and 1 for everything else
+uint64_t ClusterWidth(std::string_view cluster);
+
+// Appends the byte offset of the cluster covering each column of str from byte from on to offsets
+// from has to be the start of a cluster, clusters of width 0 are merged into the previous one
+void IndexColumns(std::string_view str, uint64_t from, std::vector<uint32_t>& offsets);
+
+} // namespace LibTesix
@@ -1,9 +1,16 @@
 #pragma once
 
+#include "Damage.h"
 #include "Json.h"
 #include "Overlay.h"
+#include "Screen.h"
 #include "StyledString.h"
+#include "StyledStringView.h"
 
+#include <fmt/format.h>
+#include <iterator>
+#include <span>
+#include <string_view>
 #include <unicode/unistr.h>
 #include <vector>
 
@@ -13,34 +20,89 @@ typedef std::pair<int64_t, int64_t> Range;
 
 Range ClampRange(uint64_t max, Range range);
 
+// Text to be written at col, line of a window
+struct WindowSpan {
+    uint64_t col;
+    uint64_t line;
+    std::string_view str;
+    StyleId style;
+};
+
 void ApplySegmentArray(StyledSegmentArray& arr, StyledString& str, uint64_t offset = 0);
 
 class Window {
   public:
-    Window(int64_t x, int64_t y, uint64_t width, uint64_t height, const Style* style = style_allocator[0UL]);
+    Window(int64_t x, int64_t y, uint64_t width, uint64_t height, StyleId style = STANDARD_STYLE);
     Window(JsonDocument& json, const char* name);
     Window(JsonDocument& json, rapidjson::Value& json_window);
 
-  public:
-    void Draw(Style& state, bool should_update = true);
-
-    void Write(uint64_t col, uint64_t line, icu::UnicodeString& str, const Style* style);
-    void Write(uint64_t col, uint64_t line, const char* str, const Style* style);
+    ~Window();
 
+  public:
+    // The visible lines are referenced by out instead of copied, they are copied into out only if they change before it is flushed
+    void Draw(StyleId& state, bool should_update = true, OutputBuffer& out = output);
+    // Draws the window into the back buffer of screen
+    void Draw(Screen& screen);
+    // Draws the columns from start to end (exclusive) of line, which have to be on the terminal
+    // If they are the whole visible part of the line it is referenced from the cache like in Draw, otherwise it is serialized into out
+    void DrawLine(uint64_t line, uint64_t start, uint64_t end, StyleId& state, OutputBuffer& out = output);
+
+    void Write(uint64_t col, uint64_t line, std::string_view str, StyleId style);
+    void Write(uint64_t col, uint64_t line, const icu::UnicodeString& str, StyleId style);
+    void Write(uint64_t col, uint64_t line, const char* str, StyleId style);
+    // Writes every span with a single pass over each line, unlike the other writes text that doesn't fit is cut off at the end of the line
+    // The spans have to be sorted by line and col and mustn't overlap
+    void Write(std::span<const WindowSpan> spans);
+
+    // Formats args into a buffer that is kept by the window and writes the result like Write, the format string is checked at compile time
+    // Formatting uses fmt, std::format isn't available with every supported standard library
+    template<class... Args> void Format(uint64_t col, uint64_t line, StyleId style, fmt::format_string<Args...> fmt, Args&&... args) {
+        format_buffer.clear();
+        fmt::format_to(std::back_inserter(format_buffer), fmt, std::forward<Args>(args)...);
+
+        Write(col, line, std::string_view(format_buffer), style);
+    }
+
+    // The overlay is the layer OVERLAY_LAYER at z 0
     void ApplyOverlay(Overlay& overlay);
     void ApplyOverlay();
     void RemoveOverlay();
 
+    // Layers are drawn on top of the lines ordered by their z, layers with the same z are drawn in the order they were added
+    // The gaps between the segments of a layer are transparent
+    // Returns the id of the new layer
+    uint64_t AddLayer(const Overlay& overlay, int64_t z = 0);
+    void RemoveLayer(uint64_t id);
+    // The window is drawn again as a whole after the returned overlay was changed, it is valid until layers are added or removed
+    Overlay& GetLayer(uint64_t id);
+    void SetLayerZ(uint64_t id, int64_t z);
+    void ShowLayer(uint64_t id, bool visible);
+
+    static constexpr uint64_t OVERLAY_LAYER = 0;
+
     void Move(int64_t x, int64_t y);
     void Resize(uint64_t width, uint64_t height);
 
-    void Clear(const Style* style);
+    // Moves the content of the window up by n lines (down if n is negative), the exposed lines are cleared, layers don't move
+    // If the window spans the whole width of the terminal and has no visible layers the next Draw scrolls the terminal and only draws the
+    // lines that changed, this expects the window to still be displayed as it was last drawn
+    void Scroll(int64_t n);
+
+    void Clear(StyleId style);
 
     void UpdateRaw();
 
     uint64_t GetHeight();
     uint64_t GetWidth();
 
+    // The area of the terminal the window covers
+    Rect Bounds() const;
+
+    // The areas of the terminal that changed since the damage was last cleared or the window was drawn with UpdateRaw
+    // Moving or resizing damages the old and the new bounds of the window, writing damages the written columns
+    const std::vector<Rect>& GetDamage() const;
+    void ClearDamage();
+
     int64_t GetX();
     int64_t GetY();
 
@@ -49,16 +111,115 @@ class Window {
     bool LoadFromJson(JsonDocument& json, rapidjson::Value& json_window);
 
   private:
-    std::vector<StyledString> lines;
+    // Marks every line to be serialized again on the next UpdateRaw
+    void MarkDirty();
+    void MarkDirty(uint64_t line);
+
+    // Lines are stored as a ring starting at first_line, this returns the index of a line in lines and raw_lines
+    uint64_t LineIndex(uint64_t line) const;
+    StyledString& Line(uint64_t line);
+
+    // Makes lines start at index 0 again
+    void Unroll();
+
+    // Serializes the columns x_visible of line into its RawLine
+    void SerializeLine(uint64_t line, Range x_visible);
+    // The visible layers that have the given line, from the bottom to the top
+    std::span<const StyledSegmentArray* const> LineLayers(uint64_t line);
+
+    struct Layer {
+        uint64_t id;
+        int64_t z;
+        // Counts up in the order the layers were added, the overlay layer has a fixed id and can be added after other layers
+        uint64_t order;
+        bool visible;
+
+        Overlay overlay;
+    };
 
-    Overlay overlay;
-    bool overlay_enabled = false;
-    bool has_overlay = false;
+    // Returns the layer with the given id, throws if there is none
+    Layer& FindLayer(uint64_t id, const char* caller);
+    void SortLayers();
 
+    void Damage(const Rect& rect);
+
+    static constexpr uint64_t MAX_DAMAGE_RECTS = 64;
+
+    // Has the output the lines were last drawn to copy them if it wasn't flushed or destroyed yet
+    // Called before a line referenced in the current frame is serialized again and before raw_lines is resized or reordered
+    void ReleaseOutput();
+    // Makes out the output that references the lines, releases the previous one if it is a different output or frame
+    void Reference(OutputBuffer& out);
+
+    // The serialized bytes of a single visible line, the cursor movement in front of it is added by UpdateRaw
+    // Moving the window only changes the cursor movement, the bytes are reused as long as the line is clipped the same way
+    struct RawLine {
+        std::string raw;
+
+        StyleId start_style;
+        StyleId end_style;
+
+        // The columns of the line raw was serialized from
+        Range clip = Range(-1, -1);
+
+        // The reference_epoch raw was last handed to the output in
+        uint64_t referenced = 0;
+
+        // Set if the line changed since raw was last serialized
+        bool dirty = true;
+    };
+
+  private:
+    std::vector<StyledString> lines;
+    uint64_t first_line = 0;
+
+    // The style lines are cleared with
+    StyleId clear_style = STANDARD_STYLE;
+
+    // Sorted by z from the bottom to the top
+    std::vector<Layer> layers;
+    uint64_t next_layer_id = OVERLAY_LAYER + 1;
+    uint64_t next_layer_order = 0;
+    // Reused by LineLayers
+    std::vector<const StyledSegmentArray*> line_layers;
+    // Reused by Write
+    std::vector<StyledSpan> line_spans;
+
+    // A line placed in the output at offset in raw
+    struct DrawnLine {
+        uint64_t offset;
+        uint64_t line_index;
+    };
+
+    // The cursor movements and style changes around the drawn lines, the lines themselves are kept in raw_lines
     std::string raw;
+    std::vector<DrawnLine> drawn_lines;
+    std::vector<RawLine> raw_lines;
+
+    std::vector<Rect> damage;
+
+    // The output that references raw_lines until its frame changes, only a handle is kept as the output can be destroyed before the window
+    std::weak_ptr<OutputBuffer*> referencing_output;
+    uint64_t referencing_frame = 0;
+    // Changes whenever the referencing output or its frame does, only lines stamped with the current epoch are referenced
+    uint64_t reference_epoch = 1;
+
+    // Reused by Format so formatting doesn't allocate once the buffer is large enough
+    std::string format_buffer;
+
+    // The terminal size raw_lines were clipped to
+    uint64_t raw_terminal_width = 0;
+    uint64_t raw_terminal_height = 0;
+    // The style generation raw_lines were serialized in
+    uint64_t raw_style_generation = 0;
+
+    // Set once every visible line was drawn, cleared if the whole window has to be drawn again
+    bool raw_complete = false;
+    // The lines the window was scrolled by since the last UpdateRaw
+    int64_t pending_scroll = 0;
 
-    const Style* raw_start_style;
-    const Style* raw_end_style;
+    StyleId raw_start_style = NO_STYLE;
+    StyleId raw_end_style;
 
     int64_t x;
     int64_t y;
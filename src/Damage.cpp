@@ -0,0 +1,79 @@
+#include "Damage.h"
+
+#include <algorithm>
+
+namespace LibTesix {
+
+void AddSpan(std::vector<Span>& spans, int64_t start, int64_t end) {
+    if(start >= end) return;
+
+    // The spans before the new one end before it starts
+    uint64_t insert = 0;
+
+    while(insert < spans.size() && spans[insert].second < start) {
+        insert++;
+    }
+
+    // The spans that touch or overlap the new one are merged into it
+    uint64_t merge_end = insert;
+    Span merged(start, end);
+
+    while(merge_end < spans.size() && spans[merge_end].first <= end) {
+        merged.first = std::min(merged.first, spans[merge_end].first);
+        merged.second = std::max(merged.second, spans[merge_end].second);
+        merge_end++;
+    }
+
+    spans.erase(spans.begin() + insert, spans.begin() + merge_end);
+    spans.insert(spans.begin() + insert, merged);
+}
+
+DamageRegion::DamageRegion() {
+}
+
+void DamageRegion::Add(const Rect& rect) {
+    int64_t start = std::max<int64_t>(rect.x, 0);
+    int64_t end = std::min<int64_t>(rect.x + rect.width, width);
+
+    if(start >= end) return;
+
+    int64_t first_line = std::max<int64_t>(rect.y, 0);
+    int64_t end_line = std::min<int64_t>(rect.y + rect.height, lines.size());
+
+    for(int64_t line = first_line; line < end_line; line++) {
+        AddSpan(lines[line], start, end);
+    }
+}
+
+void DamageRegion::AddAll() {
+    for(std::vector<Span>& line : lines) {
+        line.assign(1, Span(0, width));
+    }
+}
+
+void DamageRegion::Resize(uint64_t width, uint64_t height) {
+    this->width = width;
+    lines.resize(height);
+
+    AddAll();
+}
+
+void DamageRegion::Clear() {
+    for(std::vector<Span>& line : lines) {
+        line.clear();
+    }
+}
+
+const std::vector<Span>& DamageRegion::Line(uint64_t line) const {
+    return lines[line];
+}
+
+uint64_t DamageRegion::GetWidth() const {
+    return width;
+}
+
+uint64_t DamageRegion::GetHeight() const {
+    return lines.size();
+}
+
+} // namespace LibTesix
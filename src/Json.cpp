@@ -9,17 +9,11 @@
 namespace LibTesix {
 
 Color ReadColor(rapidjson::Value& json_color) {
-    Color color;
-
     uint64_t r = json_color.HasMember("r") ? json_color["r"].GetUint64() : 0;
     uint64_t g = json_color.HasMember("r") ? json_color["g"].GetUint64() : 0;
     uint64_t b = json_color.HasMember("r") ? json_color["b"].GetUint64() : 0;
 
-    color.r = r;
-    color.g = g;
-    color.b = b;
-
-    return color;
+    return Color(r, g, b);
 }
 
 enum class Thickness { FAINT = 0, NORMAL = 1, BOLD = 2 };
@@ -62,12 +56,12 @@ void AllocStyles(rapidjson::Value& json_styles) {
     }
 }
 
-const Style* GetStylePointer(const std::string& name) {
-    const Style* style_p = style_allocator[name];
+StyleId GetStyleId(const std::string& name) {
+    StyleId id = style_allocator.Id(name);
 
-    if(style_p == nullptr) return STANDARD_STYLE;
+    if(id == NO_STYLE) return STANDARD_STYLE;
 
-    return style_p;
+    return id;
 }
 
 StyledSegmentArray ReadSegmentArray(rapidjson::Value& json_arr) {
@@ -79,7 +73,7 @@ StyledSegmentArray ReadSegmentArray(rapidjson::Value& json_arr) {
 
     for(uint64_t i = 0; i < json_segments.Size(); i++) {
         std::string str = json_segments[i].HasMember("string") ? json_segments[i]["string"].GetString() : "";
-        const Style* style = GetStylePointer(json_segments[i].HasMember("style") ? json_segments[i]["style"].GetString() : "");
+        StyleId style = GetStyleId(json_segments[i].HasMember("style") ? json_segments[i]["style"].GetString() : "");
         uint64_t start = json_segments[i].HasMember("start") ? json_segments[i]["start"].GetUint64() : 0;
 
         arr.Add(str.c_str(), style, start);
@@ -128,9 +122,10 @@ bool Window::LoadFromJson(JsonDocument& json, rapidjson::Value& json_window) {
     height = json_window.HasMember("height") ? json_window["height"].GetUint64() : 0;
 
     if(json_window.HasMember("overlay_enabled") ? json_window["overlay_enabled"].GetBool() : false) {
+        Overlay overlay;
         overlay.LoadFromJson(json, json_window.HasMember("overlay") ? json_window["overlay"].GetString() : "");
-        overlay_enabled = true;
-        has_overlay = true;
+
+        ApplyOverlay(overlay);
     }
 
     if(!json_window.HasMember("lines")) return false;
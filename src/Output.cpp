@@ -0,0 +1,184 @@
+#include "Output.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <climits>
+
+namespace LibTesix {
+
+OutputBuffer::OutputBuffer(int fd) {
+    this->fd = fd;
+
+    handle = std::make_shared<OutputBuffer*>(this);
+}
+
+void OutputBuffer::Append(const char* data, uint64_t len) {
+    buffer.append(data, len);
+    AddBuffered(len);
+}
+
+void OutputBuffer::Append(std::string_view str) {
+    buffer.append(str);
+    AddBuffered(str.size());
+}
+
+void OutputBuffer::Append(char c) {
+    buffer.push_back(c);
+    AddBuffered(1);
+}
+
+void OutputBuffer::Append(uint64_t count, char c) {
+    buffer.append(count, c);
+    AddBuffered(count);
+}
+
+void OutputBuffer::AppendNumber(uint64_t num) {
+    char digits[20];
+    char* end = std::to_chars(digits, digits + sizeof(digits), num).ptr;
+
+    buffer.append(digits, end - digits);
+    AddBuffered(end - digits);
+}
+
+void OutputBuffer::AppendRef(std::string_view str) {
+    if(str.size() == 0) return;
+
+    // Everything that was buffered so far comes first
+    if(pieces.size() == 0 && buffer.size() > 0) pieces.push_back(Piece{nullptr, 0, buffer.size()});
+
+    pieces.push_back(Piece{str.data(), 0, str.size()});
+    referenced += str.size();
+}
+
+void OutputBuffer::AddBuffered(uint64_t len) {
+    if(pieces.size() == 0 || len == 0) return;
+
+    if(pieces.back().data == nullptr) {
+        pieces.back().len += len;
+    } else {
+        pieces.push_back(Piece{nullptr, buffer.size() - len, len});
+    }
+}
+
+void OutputBuffer::MoveCursor(uint64_t col, uint64_t line) {
+    Append("\033[", 2);
+    AppendNumber(line + 1);
+    Append(';');
+    AppendNumber(col + 1);
+    Append('f');
+}
+
+bool OutputBuffer::Flush() {
+    if(pieces.size() > 0) {
+        bool success = FlushPieces();
+
+        Clear();
+        return success;
+    }
+
+    uint64_t written = 0;
+
+    while(written < buffer.size()) {
+        ssize_t ret = write(fd, buffer.data() + written, buffer.size() - written);
+
+        if(ret < 0) {
+            if(errno == EINTR) continue;
+
+            Clear();
+            return false;
+        }
+
+        written += ret;
+    }
+
+    Clear();
+    return true;
+}
+
+bool OutputBuffer::FlushPieces() {
+    iov.clear();
+
+    for(const Piece& piece : pieces) {
+        const char* data = piece.data != nullptr ? piece.data : buffer.data() + piece.offset;
+
+        iov.push_back(iovec{const_cast<char*>(data), piece.len});
+    }
+
+    uint64_t index = 0;
+
+    while(index < iov.size()) {
+        ssize_t ret = writev(fd, iov.data() + index, std::min<uint64_t>(iov.size() - index, IOV_MAX));
+
+        if(ret < 0) {
+            if(errno == EINTR) continue;
+
+            return false;
+        }
+
+        // A partial write can end in the middle of a piece
+        while(index < iov.size() && static_cast<uint64_t>(ret) >= iov[index].iov_len) {
+            ret -= iov[index].iov_len;
+            index++;
+        }
+
+        if(index < iov.size()) {
+            iov[index].iov_base = static_cast<char*>(iov[index].iov_base) + ret;
+            iov[index].iov_len -= ret;
+        }
+    }
+
+    return true;
+}
+
+void OutputBuffer::Clear() {
+    buffer.clear();
+    pieces.clear();
+    referenced = 0;
+
+    frame++;
+}
+
+void OutputBuffer::CopyReferences() {
+    if(pieces.size() == 0) return;
+
+    // The frame is flattened into a second buffer that is swapped in, both keep their capacity for the next time
+    flat.clear();
+    flat.reserve(Size());
+
+    for(const Piece& piece : pieces) {
+        flat.append(piece.data != nullptr ? piece.data : buffer.data() + piece.offset, piece.len);
+    }
+
+    buffer.swap(flat);
+    pieces.clear();
+    referenced = 0;
+}
+
+uint64_t OutputBuffer::Frame() const {
+    return frame;
+}
+
+std::weak_ptr<OutputBuffer*> OutputBuffer::Handle() const {
+    return handle;
+}
+
+void OutputBuffer::SetFd(int fd) {
+    this->fd = fd;
+}
+
+int OutputBuffer::GetFd() const {
+    return fd;
+}
+
+const char* OutputBuffer::Data() {
+    CopyReferences();
+
+    return buffer.data();
+}
+
+uint64_t OutputBuffer::Size() const {
+    return buffer.size() + referenced;
+}
+
+} // namespace LibTesix
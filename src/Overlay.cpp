@@ -32,12 +32,12 @@ void Overlay::Clear() {
     }
 }
 
-void Overlay::Box(uint64_t x, uint64_t y, uint64_t width, uint64_t height, const Style* style, const char* right, const char* left, const char* top,
+void Overlay::Box(uint64_t x, uint64_t y, uint64_t width, uint64_t height, StyleId style, const char* right, const char* left, const char* top,
     const char* bottom, const char* top_right, const char* top_left, const char* bottom_right, const char* bottom_left) {
-    icu::UnicodeString top_str;
+    std::string top_str;
     top_str.append(top_right);
     for(uint64_t i = 0; i < width - 2; i++) {
-        top_str.append(icu::UnicodeString(top));
+        top_str.append(top);
     }
     top_str.append(top_left);
 
@@ -45,10 +45,10 @@ void Overlay::Box(uint64_t x, uint64_t y, uint64_t width, uint64_t height, const
     middle.Add(right, style, 0);
     middle.Add(left, style, width - 1);
 
-    icu::UnicodeString bottom_str;
+    std::string bottom_str;
     bottom_str.append(bottom_right);
     for(uint64_t i = 0; i < width - 2; i++) {
-        bottom_str.append(icu::UnicodeString(bottom));
+        bottom_str.append(bottom);
     }
     bottom_str.append(bottom_left);
 
@@ -61,7 +61,7 @@ void Overlay::Box(uint64_t x, uint64_t y, uint64_t width, uint64_t height, const
     lines[height - 1].Add(bottom_str, style, 0);
 }
 
-void Overlay::Box(const Style* style, const char* right, const char* left, const char* top, const char* bottom, const char* top_right,
+void Overlay::Box(StyleId style, const char* right, const char* left, const char* top, const char* bottom, const char* top_right,
     const char* top_left, const char* bottom_right, const char* bottom_left) {
     UpdateWidth();
     Box(0, 0, width, height, style, right, left, top, bottom, top_right, top_left, bottom_right, bottom_left);
@@ -71,10 +71,9 @@ void Overlay::UpdateWidth() {
     uint64_t new_width {};
 
     for(StyledSegmentArray& arr : lines) {
-        for(StyledSegment seg : arr.segments) {
-            if(seg.start + seg.str.length() > new_width) {
-                new_width = seg.start + seg.str.length();
-            }
+        // The segments are sorted, so the last one ends the line
+        if(arr.Len() > new_width) {
+            new_width = arr.Len();
         }
     }
     width = new_width;
@@ -0,0 +1,179 @@
+#include "Scene.h"
+
+#include "Terminal.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace LibTesix {
+
+Scene::Scene() {
+}
+
+uint64_t Scene::AddWindow(const Window& window, int64_t z) {
+    uint64_t id = next_id++;
+
+    windows.push_back(Entry{id, z, std::make_unique<Window>(window)});
+    damage.Add(window.Bounds());
+    SortWindows();
+
+    return id;
+}
+
+void Scene::RemoveWindow(uint64_t id) {
+    Entry& entry = FindEntry(id, "RemoveWindow");
+
+    damage.Add(entry.window->Bounds());
+    windows.erase(windows.begin() + (&entry - windows.data()));
+}
+
+Window& Scene::GetWindow(uint64_t id) {
+    return *FindEntry(id, "GetWindow").window;
+}
+
+void Scene::SetZ(uint64_t id, int64_t z) {
+    Entry& entry = FindEntry(id, "SetZ");
+
+    entry.z = z;
+    damage.Add(entry.window->Bounds());
+
+    SortWindows();
+}
+
+void Scene::SetBackground(StyleId style) {
+    background = style;
+
+    damage.AddAll();
+}
+
+void Scene::Draw(StyleId& state, OutputBuffer& out) {
+    // The callbacks can still move or resize windows before they are drawn
+    HandleResize();
+
+    int64_t terminal_width = GetTerminalWidth();
+    int64_t terminal_height = GetTerminalHeight();
+
+    // After a resize it can't be known what the terminal shows
+    if(damage.GetWidth() != static_cast<uint64_t>(terminal_width) || damage.GetHeight() != static_cast<uint64_t>(terminal_height)) {
+        damage.Resize(terminal_width, terminal_height);
+    }
+
+    if(style_allocator.Generation() != style_generation) {
+        style_generation = style_allocator.Generation();
+        damage.AddAll();
+    }
+
+    for(Entry& entry : windows) {
+        for(const Rect& rect : entry.window->GetDamage()) {
+            damage.Add(rect);
+        }
+
+        entry.window->ClearDamage();
+    }
+
+    covered.resize(terminal_height);
+
+    for(std::vector<Span>& line : covered) {
+        line.clear();
+    }
+
+    // Windows are drawn from the top down, everything a window covers is skipped by the windows below it
+    for(uint64_t w = windows.size(); w-- > 0;) {
+        Window& window = *windows[w].window;
+
+        int64_t x = window.GetX();
+        int64_t y = window.GetY();
+
+        int64_t start = std::max<int64_t>(x, 0);
+        int64_t end = std::min<int64_t>(x + window.GetWidth(), terminal_width);
+
+        if(start >= end) continue;
+
+        for(int64_t line = std::max<int64_t>(y, 0); line < std::min<int64_t>(y + window.GetHeight(), terminal_height); line++) {
+            Uncover(covered[line], start, end, visible);
+            Intersect(visible, damage.Line(line), damaged);
+
+            for(const Span& span : damaged) {
+                window.DrawLine(line - y, span.first - x, span.second - x, state, out);
+            }
+        }
+    }
+
+    // The damaged cells no window covers are filled with the background, a window moving off them left its text there
+    for(int64_t line = 0; line < terminal_height; line++) {
+        Uncover(covered[line], 0, terminal_width, visible);
+        Intersect(visible, damage.Line(line), damaged);
+
+        for(const Span& span : damaged) {
+            out.MoveCursor(span.first, line);
+
+            if(state != background) {
+                out.Append(style_allocator.Transition(state, background));
+                state = background;
+            }
+
+            out.Append(span.second - span.first, ' ');
+        }
+    }
+
+    damage.Clear();
+}
+
+void Scene::Invalidate() {
+    damage.AddAll();
+}
+
+void Scene::SortWindows() {
+    // Ids grow in the order the windows were added, so they keep windows with the same z in that order even after their z changed
+    std::sort(windows.begin(), windows.end(), [](const Entry& a, const Entry& b) { return a.z != b.z ? a.z < b.z : a.id < b.id; });
+}
+
+Scene::Entry& Scene::FindEntry(uint64_t id, const char* caller) {
+    for(Entry& entry : windows) {
+        if(entry.id == id) return entry;
+    }
+
+    throw std::runtime_error("Window " + std::to_string(id) + " doesn't exist! << Scene::" + caller + "()");
+}
+
+void Scene::Uncover(std::vector<Span>& covered, int64_t start, int64_t end, std::vector<Span>& visible) {
+    visible.clear();
+
+    // covered is sorted and its spans don't touch, so the gaps can be collected in a single pass
+    int64_t pos = start;
+
+    for(uint64_t i = 0; i < covered.size() && pos < end; i++) {
+        if(covered[i].second < start) continue;
+
+        if(covered[i].first > pos) visible.push_back(Span(pos, std::min(covered[i].first, end)));
+
+        pos = std::max(pos, covered[i].second);
+    }
+
+    if(pos < end) visible.push_back(Span(pos, end));
+
+    AddSpan(covered, start, end);
+}
+
+void Scene::Intersect(const std::vector<Span>& visible, const std::vector<Span>& damage, std::vector<Span>& damaged) {
+    damaged.clear();
+
+    // Both are sorted, so the overlaps are found by walking them side by side
+    uint64_t v = 0;
+    uint64_t d = 0;
+
+    while(v < visible.size() && d < damage.size()) {
+        int64_t start = std::max(visible[v].first, damage[d].first);
+        int64_t end = std::min(visible[v].second, damage[d].second);
+
+        if(start < end) damaged.push_back(Span(start, end));
+
+        if(visible[v].second < damage[d].second) {
+            v++;
+        } else {
+            d++;
+        }
+    }
+}
+
+} // namespace LibTesix
@@ -0,0 +1,230 @@
+#include "Screen.h"
+
+#include "Terminal.h"
+
+#include <cstring>
+#include <unicode/utf8.h>
+
+namespace LibTesix {
+
+static const uint64_t UNKNOWN_POSITION = UINT64_MAX;
+
+Cell::Cell() {
+    glyph[0] = ' ';
+    len = 1;
+    style = STANDARD_STYLE;
+}
+
+Cell::Cell(UChar32 glyph, StyleId style) {
+    len = 0;
+    U8_APPEND_UNSAFE(this->glyph, len, glyph);
+    this->style = style;
+}
+
+Cell::Cell(std::string_view glyph, StyleId style) {
+    if(glyph.size() > sizeof(this->glyph)) {
+        int32_t first_len = 0;
+        U8_FWD_1(glyph.data(), first_len, static_cast<int32_t>(glyph.size()));
+
+        glyph = glyph.substr(0, first_len);
+    }
+
+    len = glyph.size();
+    std::memcpy(this->glyph, glyph.data(), len);
+    this->style = style;
+}
+
+bool Cell::operator==(const Cell& other) const {
+    return len == other.len && style == other.style && std::memcmp(glyph, other.glyph, len) == 0;
+}
+
+CellBuffer::CellBuffer() {
+    width = 0;
+    height = 0;
+}
+
+CellBuffer::CellBuffer(uint64_t width, uint64_t height) {
+    this->width = width;
+    this->height = height;
+
+    cells.resize(width * height);
+}
+
+void CellBuffer::Resize(uint64_t width, uint64_t height) {
+    if(width == this->width && height == this->height) return;
+
+    std::vector<Cell> new_cells(width * height);
+
+    for(uint64_t line = 0; line < std::min(height, this->height); line++) {
+        for(uint64_t col = 0; col < std::min(width, this->width); col++) {
+            new_cells[line * width + col] = At(col, line);
+        }
+    }
+
+    cells = std::move(new_cells);
+
+    this->width = width;
+    this->height = height;
+}
+
+void CellBuffer::Fill(const Cell& cell) {
+    std::fill(cells.begin(), cells.end(), cell);
+}
+
+Cell& CellBuffer::At(uint64_t col, uint64_t line) {
+    return cells[line * width + col];
+}
+
+const Cell& CellBuffer::At(uint64_t col, uint64_t line) const {
+    return cells[line * width + col];
+}
+
+Screen::Screen() : Screen(GetTerminalWidth(), GetTerminalHeight()) {
+    fit_terminal = true;
+}
+
+Screen::Screen(uint64_t width, uint64_t height) {
+    Resize(width, height);
+}
+
+void Screen::Write(int64_t x, int64_t y, const StyledSegmentArray& str, uint64_t max_len) {
+    if(y < 0 || y >= static_cast<int64_t>(back.height)) return;
+
+    int64_t end = x + std::min(str.Len(), max_len);
+
+    for(uint64_t s = 0; s < str.SegmentCount(); s++) {
+        StyledSegmentView seg = str.Segment(s);
+        int64_t col = x + str.Start(s);
+
+        std::string_view text = seg.Str();
+
+        // The UTF-8 bytes of each cluster are copied into the cell as they are
+        for(uint64_t i = 0; i < seg.Len() && col < end;) {
+            uint64_t next = seg.NextCluster(i);
+            int64_t c_len = next - i;
+
+            // Wide clusters take up two cells, the second one is covered by the first
+            if(col >= 0 && col + c_len <= static_cast<int64_t>(back.width) && col + c_len <= end) {
+                SetCell(col, y, Cell(text.substr(seg.Offset(i), seg.Offset(next) - seg.Offset(i)), seg.style), c_len);
+            } else {
+                // Parts of a wide cluster are drawn as spaces
+                for(int64_t j = std::max<int64_t>(col, 0); j < std::min<int64_t>(col + c_len, std::min<int64_t>(back.width, end)); j++) {
+                    SetCell(j, y, Cell(' ', seg.style), 1);
+                }
+            }
+
+            col += c_len;
+            i = next;
+        }
+    }
+}
+
+void Screen::SetCell(uint64_t col, uint64_t line, const Cell& cell, uint64_t cell_width) {
+    // Overwriting only one half of a wide glyph turns the other half into a space
+    for(uint64_t i = col; i > 0 && back.At(i, line).len == 0; i--) {
+        back.At(i - 1, line) = Cell(' ', back.At(i - 1, line).style);
+    }
+
+    uint64_t end = col + cell_width;
+
+    while(end < back.width && back.At(end, line).len == 0) {
+        back.At(end, line) = Cell(' ', back.At(end, line).style);
+        end++;
+    }
+
+    back.At(col, line) = cell;
+
+    for(uint64_t i = col + 1; i < col + cell_width; i++) {
+        back.At(i, line) = cell;
+        back.At(i, line).len = 0;
+    }
+}
+
+void Screen::Clear(StyleId style) {
+    back.Fill(Cell(' ', style));
+}
+
+void Screen::Flush(StyleId& state, OutputBuffer& out) {
+    if(fit_terminal && (GetTerminalWidth() != back.width || GetTerminalHeight() != back.height)) {
+        Resize(GetTerminalWidth(), GetTerminalHeight());
+    }
+
+    if(style_allocator.Generation() != style_generation) {
+        style_generation = style_allocator.Generation();
+        Invalidate();
+    }
+
+    // Position of the terminal cursor, UNKNOWN_POSITION if it can't be known
+    uint64_t cursor_x = UNKNOWN_POSITION;
+    uint64_t cursor_y = UNKNOWN_POSITION;
+
+    for(uint64_t line = 0; line < back.height; line++) {
+        for(uint64_t col = 0; col < back.width; col++) {
+            const Cell& cell = back.At(col, line);
+
+            if(cell.len == 0 || cell == front.At(col, line)) continue;
+
+            if(cursor_y != line || cursor_x > col) {
+                out.MoveCursor(col, line);
+            } else if(cursor_x < col) {
+                out.Append("\033[", 2);
+                out.AppendNumber(col - cursor_x);
+                out.Append('C');
+            }
+
+            if(cell.style != state) {
+                out.Append(style_allocator.Transition(state, cell.style));
+                state = cell.style;
+            }
+
+            out.Append(cell.glyph, cell.len);
+
+            // Skip the cells covered by a wide glyph
+            do {
+                col++;
+            } while(col < back.width && back.At(col, line).len == 0);
+
+            // The cursor doesn't advance past the last column, its position is therefore unknown
+            cursor_x = col < back.width ? col : UNKNOWN_POSITION;
+            cursor_y = line;
+
+            col--;
+        }
+    }
+
+    front.cells = back.cells;
+
+    out.Flush();
+
+    HandleResize();
+}
+
+void Screen::Invalidate() {
+    Cell invalid;
+    invalid.style = NO_STYLE;
+
+    front.Fill(invalid);
+}
+
+void Screen::Resize(uint64_t width, uint64_t height) {
+    // Wide glyphs cut in half by the new width are turned into spaces
+    for(uint64_t line = 0; line < back.height && width < back.width; line++) {
+        if(back.At(width, line).len == 0) SetCell(width, line, Cell(' ', back.At(width, line).style), 1);
+    }
+
+    front.Resize(width, height);
+    back.Resize(width, height);
+
+    // The terminal reflows its content on resize, so it can't be known what is displayed
+    Invalidate();
+}
+
+uint64_t Screen::GetWidth() {
+    return back.width;
+}
+
+uint64_t Screen::GetHeight() {
+    return back.height;
+}
+
+} // namespace LibTesix
@@ -1,95 +1,350 @@
 #include "SegmentArray.h"
 
+#include "Unicode.h"
+
+#include <algorithm>
+#include <functional>
+#include <numeric>
 #include <stdexcept>
 
 namespace LibTesix {
 
-StyledSegment::StyledSegment(const icu::UnicodeString& str, const Style* style, uint64_t start) {
-    this->str = icu::UnicodeString(str);
-    this->style = style;
-    this->start = start;
+StyledSegment::StyledSegment(std::string_view str, StyleId style) {
+    Assign(str, style);
 }
 
-StyledSegment::StyledSegment(const char* str, const Style* style, uint64_t start) {
-    this->str = icu::UnicodeString(str);
+StyledSegment::StyledSegment(const icu::UnicodeString& str, StyleId style) {
+    str.toUTF8String(this->str);
     this->style = style;
-    this->start = start;
+
+    Index(0);
+}
+
+StyledSegment::StyledSegment(const char* str, StyleId style) : StyledSegment(std::string_view(str), style) {
 }
 
 StyledSegment::StyledSegment() {
-    str = icu::UnicodeString("");
+    style = STANDARD_STYLE;
+}
+
+void StyledSegment::Assign(std::string_view str, StyleId style) {
+    this->str.assign(str);
+    this->style = style;
 
-    style = style_allocator[0UL];
-    start = 0;
+    offsets.clear();
+    Index(0);
 }
 
 StyledSegment StyledSegment::Split(uint64_t index) {
-    if(index > str.length()) throw std::runtime_error("Index " + std::to_string(index) + " is out of bounds! << StyledSegment::Split()");
+    if(index > Len()) throw std::runtime_error("Index " + std::to_string(index) + " is out of bounds! << StyledSegment::Split()");
+
+    StyledSegment tail = Slice(index);
+
+    *this = Slice(0, index);
+
+    return tail;
+}
+
+void StyledSegment::Remove(uint64_t index, uint64_t len) {
+    index = std::min(index, Len());
+    len = std::min(len, Len() - index);
+
+    if(offsets.size() == 0) {
+        str.erase(index, len);
+        return;
+    }
+
+    StyledSegment tail = Slice(index + len);
+
+    *this = Slice(0, index);
+    Append(tail);
+}
+
+void StyledSegment::Append(std::string_view str) {
+    uint64_t from = this->str.size();
+
+    this->str.append(str);
+
+    Index(from);
+}
+
+void StyledSegment::Append(const StyledSegmentView& segment) {
+    if(offsets.size() == 0 && segment.offsets.size() == 0) {
+        str.append(segment.str);
+        return;
+    }
+
+    uint64_t byte_len = str.size();
+
+    if(offsets.size() == 0) {
+        offsets.resize(str.size());
+        std::iota(offsets.begin(), offsets.end(), 0);
+    }
+
+    for(uint64_t i = 0; i < segment.Len(); i++) {
+        offsets.push_back(byte_len + segment.Offset(i));
+    }
 
-    icu::UnicodeString substr(str, index);
+    str.append(segment.str);
+}
+
+StyledSegment StyledSegment::Slice(uint64_t index, uint64_t len) const {
+    return View().Slice(index, len);
+}
 
-    str.remove(index);
+void StyledSegment::AppendTo(std::string& out, uint64_t index, uint64_t len) const {
+    View().AppendTo(out, index, len);
+}
 
-    return StyledSegment(substr, style, start + index);
+std::string_view StyledSegment::Str() const {
+    return str;
 }
 
 uint64_t StyledSegment::Len() const {
-    return str.length();
+    return offsets.size() > 0 ? offsets.size() : str.size();
+}
+
+uint64_t StyledSegment::Offset(uint64_t index) const {
+    return View().Offset(index);
+}
+
+bool StyledSegment::IsContinuation(uint64_t index) const {
+    return View().IsContinuation(index);
+}
+
+uint64_t StyledSegment::NextCluster(uint64_t index) const {
+    return View().NextCluster(index);
+}
+
+StyledSegmentView StyledSegment::View() const {
+    return StyledSegmentView{str, offsets, style};
+}
+
+StyledSegment::operator StyledSegmentView() const {
+    return View();
+}
+
+void StyledSegment::Index(uint64_t from) {
+    if(offsets.size() == 0) {
+        uint64_t ascii_end = from + AsciiPrefix(str.data() + from, str.size() - from);
+
+        if(ascii_end == str.size()) return;
+
+        // The last ASCII character can be the base of a combining mark
+        from = ascii_end > 0 ? ascii_end - 1 : 0;
+
+        offsets.resize(from);
+        std::iota(offsets.begin(), offsets.end(), 0);
+    } else {
+        // The appended text can attach to the last cluster
+        from = offsets.back();
+
+        while(offsets.size() > 0 && offsets.back() == from) {
+            offsets.pop_back();
+        }
+    }
+
+    IndexColumns(str, from, offsets);
+}
+
+StyledSegment StyledSegmentView::Slice(uint64_t index, uint64_t len) const {
+    StyledSegment slice;
+    SliceTo(slice, index, len);
+
+    return slice;
+}
+
+void StyledSegmentView::SliceTo(StyledSegment& slice, uint64_t index, uint64_t len) const {
+    uint64_t end;
+    uint64_t lead;
+    uint64_t trail;
+
+    Clip(index, len, end, lead, trail);
+
+    uint64_t byte_start = Offset(index);
+    uint64_t byte_end = Offset(end);
+
+    slice.style = style;
+
+    slice.str.clear();
+    slice.offsets.clear();
+
+    slice.str.reserve(lead + byte_end - byte_start + trail);
+    slice.str.append(lead, ' ');
+    slice.str.append(str, byte_start, byte_end - byte_start);
+    slice.str.append(trail, ' ');
+
+    // The clusters don't change, so their offsets are copied instead of segmenting the text again
+    if(offsets.size() > 0) {
+        slice.offsets.reserve(lead + end - index + trail);
+
+        for(uint64_t i = 0; i < lead; i++) {
+            slice.offsets.push_back(i);
+        }
+
+        for(uint64_t i = index; i < end; i++) {
+            slice.offsets.push_back(offsets[i] - byte_start + lead);
+        }
+
+        for(uint64_t i = 0; i < trail; i++) {
+            slice.offsets.push_back(lead + byte_end - byte_start + i);
+        }
+    }
+}
+
+void StyledSegmentView::AppendTo(std::string& out, uint64_t index, uint64_t len) const {
+    uint64_t end;
+    uint64_t lead;
+    uint64_t trail;
+
+    Clip(index, len, end, lead, trail);
+
+    out.append(lead, ' ');
+    out.append(str, Offset(index), Offset(end) - Offset(index));
+    out.append(trail, ' ');
+}
+
+void StyledSegmentView::Clip(uint64_t& index, uint64_t len, uint64_t& end, uint64_t& lead, uint64_t& trail) const {
+    index = std::min(index, Len());
+    len = std::min(len, Len() - index);
+
+    end = index + len;
+
+    // Columns of wide clusters that are cut off on either side
+    lead = 0;
+    trail = 0;
+
+    while(index < end && IsContinuation(index)) {
+        index++;
+        lead++;
+    }
+
+    if(end < Len() && IsContinuation(end)) {
+        uint64_t cluster_start = end;
+
+        while(cluster_start > index && IsContinuation(cluster_start)) {
+            cluster_start--;
+        }
+
+        trail = end - cluster_start;
+        end = cluster_start;
+    }
+}
+
+std::string_view StyledSegmentView::Str() const {
+    return str;
+}
+
+uint64_t StyledSegmentView::Len() const {
+    return offsets.size() > 0 ? offsets.size() : str.size();
+}
+
+uint64_t StyledSegmentView::Offset(uint64_t index) const {
+    if(offsets.size() == 0) return index;
+
+    return index < offsets.size() ? offsets[index] : str.size();
+}
+
+bool StyledSegmentView::IsContinuation(uint64_t index) const {
+    return offsets.size() > 0 && index > 0 && index < offsets.size() && offsets[index] == offsets[index - 1];
+}
+
+uint64_t StyledSegmentView::NextCluster(uint64_t index) const {
+    index++;
+
+    while(IsContinuation(index)) {
+        index++;
+    }
+
+    return index;
 }
 
 StyledSegmentArray::StyledSegmentArray() {
+    byte_starts.PushBack(0);
+    column_starts.PushBack(0);
 }
 
 bool StyledSegmentArray::InSegment(uint64_t segment_index, uint64_t index) const {
-    return (index < segments[segment_index].start + segments[segment_index].Len()) && (index >= segments[segment_index].start);
+    return (index < Start(segment_index) + SegmentLen(segment_index)) && (index >= Start(segment_index));
 }
 
-void StyledSegmentArray::Append(const icu::UnicodeString& str, const Style* style) {
-    uint64_t segment_start = 0;
+void StyledSegmentArray::Append(const StyledSegmentView& segment) {
+    // Appending a segment of this array would copy text out of the buffer that is being grown
+    if(Views(segment)) {
+        Append(segment.Slice());
+        return;
+    }
 
-    if(segments.size() > 0) {
-        segment_start = segments.back().start + segments.back().Len();
+    if(styles.size() > 0 && styles.back() == segment.style) {
+        AppendToLast(segment);
+    } else {
+        InsertSegment(segment, Len(), styles.size());
     }
+}
+
+void StyledSegmentArray::Append(const icu::UnicodeString& str, StyleId style) {
+    Append(StyledSegment(str, style));
+}
 
-    segments.emplace_back(str, style, segment_start);
+void StyledSegmentArray::Append(std::string_view str, StyleId style) {
+    Append(StyledSegment(str, style));
 }
 
-void StyledSegmentArray::Append(const char* str, const Style* style) {
-    icu::UnicodeString uc_str(str);
-    Append(uc_str, style);
+void StyledSegmentArray::Append(const char* str, StyleId style) {
+    Append(StyledSegment(str, style));
 }
 
-void StyledSegmentArray::Add(const icu::UnicodeString& str, const Style* style, uint64_t index) {
-    if(str.length() == 0) return;
+void StyledSegmentArray::Add(const StyledSegmentView& new_segment, uint64_t index) {
+    uint64_t len = new_segment.Len();
 
-    StyledSegment new_segment = StyledSegment(str, style, index);
+    if(len == 0) return;
 
-    if(segments.size() == 0) {
-        InsertSegment(new_segment, 0);
+    // The text of a segment of this array would move while it is erased and inserted
+    if(Views(new_segment)) {
+        Add(new_segment.Slice(), index);
         return;
     }
 
-    if(Len() == 0) segments[0] = new_segment;
+    if(styles.size() == 0) {
+        InsertSegment(new_segment, index, 0);
+        return;
+    }
+
+    if(Len() == 0) {
+        ReplaceSegment(0, new_segment);
+        SetStart(0, index);
+        return;
+    }
 
     if(index >= Len()) {
-        segments.push_back(new_segment);
-    } else if(index + str.length() >= Len()) {
+        InsertSegment(new_segment, index, styles.size());
+        Coalesce(styles.size() - 1);
+    } else if(index + len >= Len()) {
         Erase(index, Len() - 1);
 
-        segments.push_back(new_segment);
+        InsertSegment(new_segment, index, styles.size());
+        Coalesce(styles.size() - 1);
     } else {
         uint64_t segment_index = GetSegmentIndex(index);
-        bool back = !((segments[segment_index].start == index) || !(segments[segment_index].start < index));
+        bool back = Start(segment_index) < index;
 
-        Erase(index, index + str.length() - 1);
+        Erase(index, index + len - 1);
 
-        InsertSegment(new_segment, segment_index + back);
+        InsertSegment(new_segment, index, segment_index + back);
+        Coalesce(segment_index + back);
     }
 }
 
-void StyledSegmentArray::Add(const char* str, const Style* style, uint64_t index) {
-    icu::UnicodeString uc_str(str);
-    Add(uc_str, style, index);
+void StyledSegmentArray::Add(const icu::UnicodeString& str, StyleId style, uint64_t index) {
+    Add(StyledSegment(str, style), index);
+}
+
+void StyledSegmentArray::Add(std::string_view str, StyleId style, uint64_t index) {
+    Add(StyledSegment(str, style), index);
+}
+
+void StyledSegmentArray::Add(const char* str, StyleId style, uint64_t index) {
+    Add(StyledSegment(str, style), index);
 }
 
 void StyledSegmentArray::Erase(uint64_t start, uint64_t end) {
@@ -103,40 +358,43 @@ void StyledSegmentArray::Erase(uint64_t start, uint64_t end) {
     uint64_t start_segment_index = GetSegmentIndex(start);
     uint64_t end_segment_index = GetSegmentIndex(end);
 
-    if(start < segments[start_segment_index].start) {
+    uint64_t segment_start = Start(start_segment_index);
+
+    if(start < segment_start) {
         // Remove text
-        uint64_t erase_len = (end - start + 1) - (segments[start_segment_index].start - start);
+        uint64_t erase_len = (end - start + 1) - (segment_start - start);
 
-        segments[start_segment_index].str.remove(0, erase_len);
-        segments[start_segment_index].start += erase_len;
+        ReplaceSegment(start_segment_index, Segment(start_segment_index).Slice(erase_len));
+        SetStart(start_segment_index, segment_start + erase_len);
 
         // Clean up
         Clean(start_segment_index);
     } else if(start_segment_index == end_segment_index) {
-        // Remove text
-        uint64_t erase_index = start - segments[start_segment_index].start;
+        // Remove text and split the segment around it
+        uint64_t erase_index = start - segment_start;
         uint64_t erase_len = end - start + 1;
 
-        segments[start_segment_index].str.remove(erase_index, erase_len);
+        StyledSegmentView segment = Segment(start_segment_index);
+        StyledSegment tail = segment.Slice(erase_index + erase_len);
 
-        // Split initial segment
-        InsertSegment(segments[start_segment_index].Split(erase_index), start_segment_index + 1);
-        segments[start_segment_index + 1].start += erase_len;
+        ReplaceSegment(start_segment_index, segment.Slice(0, erase_index));
+        InsertSegment(tail, start + erase_len, start_segment_index + 1);
 
         // Clean up
         Clean(start_segment_index + !Clean(start_segment_index));
     } else {
         // Remove text in start segment
-        segments[start_segment_index].Split(start - segments[start_segment_index].start);
+        ReplaceSegment(start_segment_index, Segment(start_segment_index).Slice(0, start - segment_start));
 
         // Remove everything inbetween
-        for(uint64_t i = start_segment_index + 1; i < end_segment_index;) {
-            segments.erase(segments.begin() + i);
-            end_segment_index--;
-        }
+        EraseSegment(start_segment_index + 1, end_segment_index - start_segment_index - 1);
+        end_segment_index = start_segment_index + 1;
 
         // Remove text in end segment
-        segments[end_segment_index] = segments[end_segment_index].Split(end - segments[end_segment_index].start + 1);
+        uint64_t end_segment_start = Start(end_segment_index);
+
+        ReplaceSegment(end_segment_index, Segment(end_segment_index).Slice(end - end_segment_start + 1));
+        SetStart(end_segment_index, end + 1);
 
         // Clean up
         Clean(end_segment_index);
@@ -144,65 +402,403 @@ void StyledSegmentArray::Erase(uint64_t start, uint64_t end) {
     }
 }
 
+void StyledSegmentArray::Restyle(std::span<const StyleRange> ranges) {
+    if(ranges.size() == 0 || Len() == 0) return;
+
+    for(uint64_t r = 1; r < ranges.size(); r++) {
+        if(ranges[r].start <= ranges[r - 1].end) {
+            throw std::runtime_error("Range at " + std::to_string(ranges[r].start) + " overlaps the range before it << StyledSegmentArray::Restyle()");
+        }
+    }
+
+    // The text stays where it is, only the segmentation on top of it is built again
+    std::vector<uint64_t> new_starts;
+    std::vector<StyleId> new_styles;
+    std::vector<uint32_t> new_offsets;
+    std::vector<uint32_t> new_byte_starts(1, 0);
+    std::vector<uint32_t> new_column_starts(1, 0);
+
+    new_starts.reserve(styles.size() + ranges.size() * 2);
+    new_styles.reserve(styles.size() + ranges.size() * 2);
+    new_offsets.reserve(column_offsets.size());
+    new_byte_starts.reserve(styles.size() + ranges.size() * 2 + 1);
+    new_column_starts.reserve(styles.size() + ranges.size() * 2 + 1);
+
+    // The column after the last piece
+    uint64_t new_end = 0;
+
+    // Adds the columns from to to of segment as a piece in style, pieces are added in order so their text is always back to back
+    auto add_piece = [&](uint64_t segment_index, const StyledSegmentView& segment, uint64_t from, uint64_t to, StyleId style) {
+        uint64_t start = Start(segment_index) + from;
+        uint32_t byte_from = byte_starts[segment_index] + segment.Offset(from);
+        uint32_t byte_to = byte_starts[segment_index] + segment.Offset(to);
+
+        bool indexed = segment.offsets.size() > 0;
+
+        if(new_styles.size() > 0 && new_styles.back() == style && new_end == start) {
+            uint64_t last = new_styles.size() - 1;
+
+            uint32_t last_byte_len = byte_from - new_byte_starts[last];
+            bool last_indexed = new_column_starts[last + 1] > new_column_starts[last];
+
+            if(indexed || last_indexed) {
+                if(!last_indexed) {
+                    for(uint32_t i = 0; i < last_byte_len; i++) {
+                        new_offsets.push_back(i);
+                    }
+                }
+
+                for(uint64_t i = from; i < to; i++) {
+                    new_offsets.push_back(last_byte_len + segment.Offset(i) - segment.Offset(from));
+                }
+            }
+        } else {
+            new_styles.push_back(style);
+            new_starts.push_back(start);
+
+            if(indexed) {
+                for(uint64_t i = from; i < to; i++) {
+                    new_offsets.push_back(segment.offsets[i] - segment.Offset(from));
+                }
+            }
+
+            new_byte_starts.push_back(0);
+            new_column_starts.push_back(0);
+        }
+
+        new_byte_starts.back() = byte_to;
+        new_column_starts.back() = new_offsets.size();
+
+        new_end = Start(segment_index) + to;
+    };
+
+    uint64_t r = 0;
+
+    for(uint64_t i = 0; i < styles.size(); i++) {
+        StyledSegmentView segment = Segment(i);
+        uint64_t segment_start = Start(i);
+
+        for(uint64_t pos = 0; pos < segment.Len();) {
+            while(r < ranges.size() && ranges[r].end < segment_start + pos) {
+                r++;
+            }
+
+            uint64_t to;
+            StyleId style;
+
+            if(r < ranges.size() && ranges[r].start <= segment_start + pos) {
+                to = std::min(segment.Len(), ranges[r].end + 1 - segment_start);
+                style = ranges[r].style;
+            } else {
+                to = r < ranges.size() ? std::min(segment.Len(), ranges[r].start - segment_start) : segment.Len();
+                style = segment.style;
+            }
+
+            if(segment.IsContinuation(to)) to = segment.NextCluster(to);
+
+            add_piece(i, segment, pos, to, style);
+
+            pos = to;
+        }
+    }
+
+    starts.Assign(std::move(new_starts));
+    styles = std::move(new_styles);
+    column_offsets = std::move(new_offsets);
+    byte_starts.Assign(std::move(new_byte_starts));
+    column_starts.Assign(std::move(new_column_starts));
+}
+
+void StyledSegmentArray::Compact() {
+    StyledSegmentArray compact;
+
+    compact.styles.reserve(styles.size());
+    compact.starts.Reserve(styles.size());
+    compact.text.reserve(text.size());
+
+    // Runs are rebuilt into a fresh array, which leaves the text of every run contiguous
+    for(uint64_t i = 0; i < styles.size(); i++) {
+        if(i > 0 && Touching(i - 1)) {
+            compact.AppendToLast(Segment(i));
+        } else {
+            compact.InsertSegment(Segment(i), Start(i), compact.styles.size());
+        }
+    }
+
+    *this = std::move(compact);
+}
+
+uint64_t StyledSegmentArray::Coalesce(uint64_t segment_index) {
+    if(segment_index + 1 < styles.size() && Touching(segment_index)) {
+        MergeNext(segment_index);
+    }
+
+    if(segment_index > 0 && Touching(segment_index - 1)) {
+        MergeNext(segment_index - 1);
+
+        segment_index--;
+    }
+
+    return segment_index;
+}
+
+bool StyledSegmentArray::Touching(uint64_t segment_index) const {
+    return styles[segment_index] == styles[segment_index + 1] &&
+        Start(segment_index) + SegmentLen(segment_index) == Start(segment_index + 1);
+}
+
 void StyledSegmentArray::Clear() {
-    segments.clear();
+    starts.Clear();
+    styles.clear();
+    text.clear();
+    column_offsets.clear();
+
+    byte_starts.Clear();
+    byte_starts.PushBack(0);
+    column_starts.Clear();
+    column_starts.PushBack(0);
+}
+
+uint64_t StyledSegmentArray::SegmentCount() const {
+    return styles.size();
+}
+
+StyledSegmentView StyledSegmentArray::Segment(uint64_t segment_index) const {
+    uint32_t byte_start = byte_starts[segment_index];
+    uint32_t column_start = column_starts[segment_index];
+
+    return StyledSegmentView{
+        std::string_view(text.data() + byte_start, byte_starts[segment_index + 1] - byte_start),
+        std::span<const uint32_t>(column_offsets.data() + column_start, column_starts[segment_index + 1] - column_start),
+        styles[segment_index],
+    };
+}
+
+StyleId StyledSegmentArray::SegmentStyle(uint64_t segment_index) const {
+    return styles[segment_index];
+}
+
+uint64_t StyledSegmentArray::SegmentLen(uint64_t segment_index) const {
+    uint32_t columns = column_starts[segment_index + 1] - column_starts[segment_index];
+
+    // Segments without offsets are ASCII and have a column per byte
+    return columns > 0 ? columns : byte_starts[segment_index + 1] - byte_starts[segment_index];
+}
+
+bool StyledSegmentArray::Views(const StyledSegmentView& segment) const {
+    std::less_equal<const char*> less_equal;
+    std::less<const char*> less;
+
+    return segment.str.size() > 0 && less_equal(text.data(), segment.str.data()) && less(segment.str.data(), text.data() + text.size());
+}
+
+uint64_t StyledSegmentArray::Start(uint64_t segment_index) const {
+    return starts[segment_index];
+}
+
+void StyledSegmentArray::SetStart(uint64_t segment_index, uint64_t start) {
+    starts.Set(segment_index, start);
+}
+
+void StyledSegmentArray::Shift(uint64_t segment_index, int64_t delta) {
+    starts.Shift(segment_index, delta);
+}
+
+void StyledSegmentArray::InsertSegment(const StyledSegmentView& segment, uint64_t start, uint64_t index) {
+    // An empty entry is added at index and then filled with the text of segment
+    byte_starts.Insert(index, byte_starts[index]);
+    column_starts.Insert(index, column_starts[index]);
+
+    SpliceText(index, 1, &segment);
+
+    styles.insert(styles.begin() + index, segment.style);
+    starts.Insert(index, start);
+}
+
+void StyledSegmentArray::ReplaceSegment(uint64_t index, const StyledSegmentView& segment) {
+    SpliceText(index, 1, &segment);
+
+    styles[index] = segment.style;
+}
+
+void StyledSegmentArray::EraseSegment(uint64_t index, uint64_t count) {
+    if(count == 0) return;
+
+    SpliceText(index, count, nullptr);
+
+    styles.erase(styles.begin() + index, styles.begin() + index + count);
+    starts.Erase(index, count);
+}
+
+void StyledSegmentArray::AppendToLast(const StyledSegmentView& segment) {
+    uint64_t index = styles.size() - 1;
+
+    uint32_t byte_len = byte_starts[index + 1] - byte_starts[index];
+    bool indexed = column_starts[index + 1] > column_starts[index];
+
+    if(indexed || segment.offsets.size() > 0) {
+        // Once either side isn't ASCII the last segment needs an offset for every column
+        if(!indexed) {
+            column_offsets.resize(column_offsets.size() + byte_len);
+            std::iota(column_offsets.end() - byte_len, column_offsets.end(), 0);
+        }
+
+        for(uint64_t i = 0; i < segment.Len(); i++) {
+            column_offsets.push_back(byte_len + segment.Offset(i));
+        }
+    }
+
+    text.append(segment.str);
+
+    byte_starts.Set(byte_starts.Size() - 1, text.size());
+    column_starts.Set(column_starts.Size() - 1, column_offsets.size());
+}
+
+void StyledSegmentArray::SplitSegment(uint64_t segment_index, uint64_t index) {
+    StyledSegmentView segment = Segment(segment_index);
+    uint64_t start = Start(segment_index);
+
+    if(segment.IsContinuation(index)) {
+        // The halves of the cut cluster are replaced by spaces, which changes the text
+        StyledSegment tail = segment.Slice(index);
+
+        ReplaceSegment(segment_index, segment.Slice(0, index));
+        InsertSegment(tail, start + index, segment_index + 1);
+        return;
+    }
+
+    uint32_t byte_split = segment.Offset(index);
+    uint32_t column_split = column_starts[segment_index] + (segment.offsets.size() > 0 ? index : 0);
+
+    // The offsets of the new segment are relative to its own start
+    for(uint64_t i = column_split; i < column_starts[segment_index + 1]; i++) {
+        column_offsets[i] -= byte_split;
+    }
+
+    byte_starts.Insert(segment_index + 1, byte_starts[segment_index] + byte_split);
+    column_starts.Insert(segment_index + 1, column_split);
+
+    styles.insert(styles.begin() + segment_index + 1, styles[segment_index]);
+    starts.Insert(segment_index + 1, start + index);
 }
 
-void StyledSegmentArray::InsertSegment(StyledSegment segment, uint64_t index) {
-    if(index == segments.size()) {
-        segments.push_back(segment);
+void StyledSegmentArray::SpliceText(uint64_t index, uint64_t count, const StyledSegmentView* segment) {
+    std::string_view str = segment != nullptr ? segment->str : std::string_view();
+    std::span<const uint32_t> offsets = segment != nullptr ? segment->offsets : std::span<const uint32_t>();
+
+    uint32_t byte_start = byte_starts[index];
+    uint32_t byte_end = byte_starts[index + count];
+    uint32_t column_start = column_starts[index];
+    uint32_t column_end = column_starts[index + count];
+
+    text.replace(byte_start, byte_end - byte_start, str);
+
+    // Overwrite what is shared and only move the rest of the offsets once
+    uint64_t column_len = column_end - column_start;
+    uint64_t shared = std::min<uint64_t>(column_len, offsets.size());
+
+    std::copy(offsets.begin(), offsets.begin() + shared, column_offsets.begin() + column_start);
+
+    if(offsets.size() > column_len) {
+        column_offsets.insert(column_offsets.begin() + column_end, offsets.begin() + shared, offsets.end());
     } else {
-        segments.insert(segments.begin() + index, segment);
+        column_offsets.erase(column_offsets.begin() + column_start + shared, column_offsets.begin() + column_end);
+    }
+
+    // The entries after index hold the ends of the replaced segments, they are replaced by the end of segment
+    uint64_t new_count = segment != nullptr;
+
+    byte_starts.Erase(index + 1 + new_count, count - new_count);
+    column_starts.Erase(index + 1 + new_count, count - new_count);
+
+    if(new_count > 0) {
+        byte_starts.Set(index + 1, byte_start + str.size());
+        column_starts.Set(index + 1, column_start + offsets.size());
+    }
+
+    // The segments behind the new text are moved lazily
+    byte_starts.Shift(index + 1 + new_count, static_cast<int64_t>(str.size()) - (byte_end - byte_start));
+    column_starts.Shift(index + 1 + new_count, static_cast<int64_t>(offsets.size()) - static_cast<int64_t>(column_len));
+}
+
+void StyledSegmentArray::MergeNext(uint64_t segment_index) {
+    uint32_t byte_len = byte_starts[segment_index + 1] - byte_starts[segment_index];
+    uint32_t next_byte_len = byte_starts[segment_index + 2] - byte_starts[segment_index + 1];
+
+    bool indexed = column_starts[segment_index + 1] > column_starts[segment_index];
+    bool next_indexed = column_starts[segment_index + 2] > column_starts[segment_index + 1];
+
+    // The text of both segments is already back to back, only the offsets of a merge with a segment that isn't ASCII have to change
+    if(indexed || next_indexed) {
+        if(!indexed) {
+            column_offsets.insert(column_offsets.begin() + column_starts[segment_index], byte_len, 0);
+            std::iota(column_offsets.begin() + column_starts[segment_index], column_offsets.begin() + column_starts[segment_index] + byte_len, 0);
+
+            column_starts.Shift(segment_index + 1, byte_len);
+        }
+
+        if(!next_indexed) {
+            auto next = column_offsets.insert(column_offsets.begin() + column_starts[segment_index + 1], next_byte_len, 0);
+            std::iota(next, next + next_byte_len, byte_len);
+
+            column_starts.Shift(segment_index + 2, next_byte_len);
+        } else {
+            for(uint64_t i = column_starts[segment_index + 1]; i < column_starts[segment_index + 2]; i++) {
+                column_offsets[i] += byte_len;
+            }
+        }
     }
+
+    byte_starts.Erase(segment_index + 1, 1);
+    column_starts.Erase(segment_index + 1, 1);
+
+    styles.erase(styles.begin() + segment_index + 1);
+    starts.Erase(segment_index + 1, 1);
 }
 
 void StyledSegmentArray::PrintDebug() const {
     printf("|");
-    for(const StyledSegment& seg : segments) {
-        std::string utf8;
-        seg.str.toUTF8String(utf8);
-        printf("%i \"%s\"|", seg.start, utf8.c_str());
+    for(uint64_t i = 0; i < styles.size(); i++) {
+        std::string utf8(Segment(i).Str());
+        printf("%lu \"%s\"|", Start(i), utf8.c_str());
     }
-    printf("%i|\n", Len());
+    printf("%lu|\n", Len());
 }
 
 uint64_t StyledSegmentArray::Len() const {
-    if(segments.size() == 0) {
+    if(styles.size() == 0) {
         return 0;
     } else {
-        return segments.back().start + segments.back().Len();
+        return Start(styles.size() - 1) + SegmentLen(styles.size() - 1);
     }
 }
 
 uint64_t StyledSegmentArray::GetSegmentIndex(uint64_t index) const {
-    size_t segment_index = 0;
+    uint64_t upper = UpperBound(index);
 
-    if(segments.size() == 0) {
-        return 0;
-    }
+    return upper > 0 ? upper - 1 : 0;
+}
 
-    if(index >= segments.back().start) {
-        return segments.size() - 1;
-    }
+uint64_t StyledSegmentArray::UpperBound(uint64_t index) const {
+    uint64_t low = 0;
+    uint64_t high = styles.size();
 
-    for(size_t i = 0; i < segments.size() - 1; i++) {
-        if(index < segments[i + 1].start) {
-            segment_index = i;
+    while(low < high) {
+        uint64_t mid = low + (high - low) / 2;
 
-            if(segments[i + 1].start == segments[i].start) {
-                continue;
-            } else {
-                break;
-            }
+        if(Start(mid) <= index) {
+            low = mid + 1;
+        } else {
+            high = mid;
         }
     }
 
-    return segment_index;
+    return low;
 }
 
 bool StyledSegmentArray::Clean(uint64_t segment_index) {
-    if(segments[segment_index].Len() == 0) {
-        segments.erase(segments.begin() + segment_index);
+    if(SegmentLen(segment_index) == 0) {
+        EraseSegment(segment_index);
         return true;
     }
 
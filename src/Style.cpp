@@ -1,42 +1,84 @@
 #include "Style.h"
 
+#include <algorithm>
+#include <charconv>
 #include <cstring>
 #include <iostream>
 
 namespace LibTesix {
 
-// This stores the escape codes to achieve the modifiers enumerated in States found above
-// each value has two corresponding escape codes the first one is to turn that modifier off the second one to turn it on
-// To get the corresponding index from a modifier to a escape code use this formula: 2 * modifier + bool(false = off, true = on)
-const std::vector<std::string> ESCAPE_CODES = {
-    "\033[22m",
-    "\033[1m",
-    "\033[22m",
-    "\033[2m",
-    "\033[25m",
-    "\033[5m",
-    "\033[27m",
-    "\033[7m",
-    "\033[24m",
-    "\033[4m",
-    "\033[23m",
-    "\033[3m",
+// This stores the SGR parameters to achieve the modifiers enumerated in States found above
+// each value has two corresponding parameters the first one is to turn that modifier off the second one to turn it on
+// To get the corresponding index from a modifier to a parameter use this formula: 2 * modifier + bool(false = off, true = on)
+const std::vector<std::string> SGR_PARAMS = {
+    "22",
+    "1",
+    "22",
+    "2",
+    "25",
+    "5",
+    "27",
+    "7",
+    "24",
+    "4",
+    "23",
+    "3",
 };
 
-Color::Color(uint64_t r, uint64_t g, uint64_t b) {
-    this->r = r;
-    this->g = g;
-    this->b = b;
+// Appends a parameter to the SGR sequence in sgr, starting the sequence if sgr is empty
+void AppendParam(std::string& sgr, std::string_view param) {
+    sgr.append(sgr.empty() ? "\033[" : ";");
+    sgr.append(param);
+}
+
+// Appends the parameter to set a color, prefix is either "38" for the foreground or "48" for the background
+// Unset colors are reset to the default color of the terminal with prefix + 1
+void AppendColorParam(std::string& sgr, std::string_view prefix, const Color& color) {
+    char buffer[64];
+    char* end = buffer;
+
+    if(!color.IsSet()) {
+        *end++ = prefix[0];
+        *end++ = '9';
+    } else {
+        end = std::copy(prefix.begin(), prefix.end(), end);
+        end = std::copy_n(";2;", 3, end);
+        end = std::to_chars(end, buffer + sizeof(buffer), color.R()).ptr;
+        *end++ = ';';
+        end = std::to_chars(end, buffer + sizeof(buffer), color.G()).ptr;
+        *end++ = ';';
+        end = std::to_chars(end, buffer + sizeof(buffer), color.B()).ptr;
+    }
+
+    AppendParam(sgr, std::string_view(buffer, end - buffer));
+}
+
+Color::Color(uint8_t r, uint8_t g, uint8_t b) {
+    rgb = (static_cast<uint32_t>(r) << 16) | (static_cast<uint32_t>(g) << 8) | b;
 }
 
 Color::Color() {
-    r = 0;
-    g = 0;
-    b = 0;
+    rgb = 0;
 }
 
 bool Color::operator==(const Color& other) const {
-    return (r == other.r) && (g == other.g) && (b == other.b);
+    return rgb == other.rgb;
+}
+
+uint8_t Color::R() const {
+    return rgb >> 16;
+}
+
+uint8_t Color::G() const {
+    return rgb >> 8;
+}
+
+uint8_t Color::B() const {
+    return rgb;
+}
+
+bool Color::IsSet() const {
+    return rgb != UNSET;
 }
 
 ColorPair::ColorPair(Color fg, Color bg) {
@@ -114,29 +156,45 @@ bool Style::GetMod(States state) const {
 }
 
 std::string Style::GetEscapeCode(const Style& state) const {
-    std::vector<std::pair<uint64_t, bool>> bool_changes(STATES_COUNT);
+    std::string diff;
 
-    for(int64_t i = 0; i < STATES_COUNT; i++) {
-        if(modifiers[i] != state.GetMod(static_cast<States>(i))) {
-            bool_changes.emplace_back(i, modifiers[i]);
-        }
+    // Bold and faint are both turned off by 22, so it has to come before turning either of them on
+    if(modifiers[BOLD] != state.modifiers[BOLD] || modifiers[FAINT] != state.modifiers[FAINT]) {
+        if(state.modifiers[BOLD] || state.modifiers[FAINT]) AppendParam(diff, SGR_PARAMS[2 * BOLD]);
+        if(modifiers[BOLD]) AppendParam(diff, SGR_PARAMS[2 * BOLD + 1]);
+        if(modifiers[FAINT]) AppendParam(diff, SGR_PARAMS[2 * FAINT + 1]);
     }
 
-    std::string ret;
-
-    for(std::pair<uint64_t, bool> change : bool_changes) {
-        ret.append(ESCAPE_CODES[2 * change.first + change.second]);
+    for(int64_t i = BLINKING; i < STATES_COUNT; i++) {
+        if(modifiers[i] != state.modifiers[i]) AppendParam(diff, SGR_PARAMS[2 * i + modifiers[i]]);
     }
 
-    if(!(col.fg == state.col.fg)) {
-        ret.append("\033[38;2;" + std::to_string(col.fg.r) + ";" + std::to_string(col.fg.g) + ";" + std::to_string(col.fg.b) + "m");
-    }
+    if(!(col.fg == state.col.fg)) AppendColorParam(diff, "38", col.fg);
+    if(!(col.bg == state.col.bg)) AppendColorParam(diff, "48", col.bg);
+
+    if(diff.empty()) return diff;
+
+    diff.push_back('m');
+
+    // Resetting everything and setting what this style needs can be shorter than the difference
+    std::string reset = GetEscapeCode();
 
-    if(!(col.bg == state.col.bg)) {
-        ret.append("\033[48;2;" + std::to_string(col.bg.r) + ";" + std::to_string(col.bg.g) + ";" + std::to_string(col.bg.b) + "m");
+    return reset.size() < diff.size() ? reset : diff;
+}
+
+std::string Style::GetEscapeCode() const {
+    std::string reset = "\033[0";
+
+    for(int64_t i = 0; i < STATES_COUNT; i++) {
+        if(modifiers[i]) AppendParam(reset, SGR_PARAMS[2 * i + 1]);
     }
 
-    return ret;
+    if(col.fg.IsSet()) AppendColorParam(reset, "38", col.fg);
+    if(col.bg.IsSet()) AppendColorParam(reset, "48", col.bg);
+
+    reset.push_back('m');
+
+    return reset;
 }
 
 void Style::Reset() {
@@ -147,32 +205,168 @@ void Style::Reset() {
 
 StyleAllocator::StyleAllocator() {
     ids["__default"] = 0;
-    styles.push_back(std::make_unique<const Style>("__default"));
+    styles.push_back(Style("__default"));
+    references.push_back(NAMED);
+    versions.push_back(0);
 }
 
 const Style* StyleAllocator::operator[](const std::string& name) {
     if(ids.contains(name)) {
-        uint64_t id = ids[name];
-        return styles[id].get();
+        StyleId id = ids[name];
+        return &styles[id];
     }
 
     return nullptr;
 }
 
-const Style* StyleAllocator::operator[](uint64_t id) {
-    return (id < styles.size()) ? styles[id].get() : nullptr;
+const Style* StyleAllocator::operator[](StyleId id) {
+    return Valid(id) ? &styles[Index(id)] : nullptr;
 }
 
-const Style* StyleAllocator::Add(const Style& style) {
+StyleId StyleAllocator::Id(const std::string& name) {
+    auto iter = ids.find(name);
+
+    return iter != ids.end() ? iter->second : NO_STYLE;
+}
+
+StyleId StyleAllocator::Add(const Style& style) {
     if(!ids.contains(style.name)) {
+        if(styles.size() >= INDEX_MASK) throw std::runtime_error("Too many styles! << StyleAllocator::Add()");
+
         ids[style.name] = styles.size();
 
-        styles.push_back(std::make_unique<const Style>(style));
+        styles.push_back(style);
+        references.push_back(NAMED);
+        versions.push_back(0);
+
+        return styles.size() - 1;
+    } else {
+        return ids[style.name];
+    }
+}
+
+StyleId StyleAllocator::Set(const Style& style) {
+    if(!ids.contains(style.name)) return Add(style);
+
+    StyleId id = ids[style.name];
+
+    styles[id] = style;
+    ClearTransitions(id);
+
+    generation++;
+
+    return id;
+}
+
+StyleId StyleAllocator::Intern(const Style& style) {
+    StyleKey key(style);
+
+    auto iter = interned.find(key);
 
-        return styles.back().get();
+    if(iter != interned.end()) {
+        references[Index(iter->second)]++;
+        return iter->second;
+    }
+
+    uint32_t index;
+
+    if(free_indices.empty()) {
+        if(styles.size() >= INDEX_MASK) throw std::runtime_error("Too many styles! << StyleAllocator::Intern()");
+
+        index = styles.size();
+
+        styles.push_back(style);
+        references.push_back(1);
+        versions.push_back(0);
     } else {
-        return (*this)[style.name];
+        index = free_indices.back();
+        free_indices.pop_back();
+
+        styles[index] = style;
+        references[index] = 1;
+
+        // A new version, so ids still held for the freed style do not name this one
+        versions[index] = (versions[index] + 1) & VERSION_MASK;
+    }
+
+    StyleId id = (versions[index] << INDEX_BITS) | index;
+
+    styles[index].name.clear();
+    interned[key] = id;
+
+    return id;
+}
+
+void StyleAllocator::Retain(StyleId id) {
+    if(!Valid(id) || references[Index(id)] == NAMED) return;
+
+    references[Index(id)]++;
+}
+
+void StyleAllocator::Release(StyleId id) {
+    if(!Valid(id) || references[Index(id)] == NAMED) return;
+
+    uint32_t index = Index(id);
+
+    references[index]--;
+
+    if(references[index] == 0) {
+        interned.erase(StyleKey(styles[index]));
+        free_indices.push_back(index);
     }
 }
 
+uint64_t StyleAllocator::Generation() const {
+    return generation;
+}
+
+void StyleAllocator::ClearTransitions(StyleId id) {
+    std::erase_if(transitions, [id](const auto& transition) { return transition.first >> 32 == id || (transition.first & UINT32_MAX) == id; });
+}
+
+uint32_t StyleAllocator::Index(StyleId id) {
+    return id & INDEX_MASK;
+}
+
+bool StyleAllocator::Valid(StyleId id) const {
+    uint32_t index = Index(id);
+
+    return id != NO_STYLE && index < styles.size() && references[index] != 0 && versions[index] == id >> INDEX_BITS;
+}
+
+StyleAllocator::StyleKey::StyleKey(const Style& style) {
+    fg = style.col.fg.rgb;
+    bg = style.col.bg.rgb;
+    modifiers = style.modifiers.to_ullong();
+}
+
+bool StyleAllocator::StyleKey::operator==(const StyleKey& other) const {
+    return fg == other.fg && bg == other.bg && modifiers == other.modifiers;
+}
+
+uint64_t StyleAllocator::StyleKeyHash::operator()(const StyleKey& key) const {
+    uint64_t colors = (static_cast<uint64_t>(key.fg) << 32) | key.bg;
+
+    return std::hash<uint64_t>()(colors ^ (key.modifiers * 0x9E3779B97F4A7C15));
+}
+
+std::string_view StyleAllocator::Transition(StyleId from, StyleId to) {
+    if(!Valid(to)) return std::string_view();
+
+    // A freed style can still be the state of the terminal, but what it looked like is gone
+    if(!Valid(from)) from = NO_STYLE;
+
+    uint64_t key = (static_cast<uint64_t>(from) << 32) | to;
+
+    auto iter = transitions.find(key);
+
+    if(iter != transitions.end()) return iter->second;
+
+    if(transitions.size() >= MAX_TRANSITIONS) transitions.clear();
+
+    std::string code = from == NO_STYLE ? styles[Index(to)].GetEscapeCode() : styles[Index(to)].GetEscapeCode(styles[Index(from)]);
+
+    return transitions.emplace(key, std::move(code)).first->second;
+}
+
 } // namespace LibTesix
@@ -0,0 +1,256 @@
+#include "StyledRope.h"
+
+#include <stdexcept>
+
+namespace LibTesix {
+
+StyledRope::StyledRope() {
+}
+
+StyledRope::StyledRope(const icu::UnicodeString& base_string, StyleId style) {
+    Append(base_string, style);
+}
+
+StyledRope::StyledRope(std::string_view base_string, StyleId style) {
+    Append(base_string, style);
+}
+
+StyledRope::StyledRope(const char* base_string, StyleId style) {
+    Append(base_string, style);
+}
+
+void StyledRope::Insert(const StyledSegment& segment, uint64_t index) {
+    if(index > Len()) throw std::runtime_error("Index " + std::to_string(index) + " is out of bounds! << StyledRope::Insert()");
+
+    if(segment.Len() == 0) return;
+
+    std::pair<uint64_t, uint64_t> halves = Split(root, index);
+
+    root = Merge(Merge(halves.first, Build(segment)), halves.second);
+}
+
+void StyledRope::Insert(const icu::UnicodeString& str, StyleId style, uint64_t index) {
+    Insert(StyledSegment(str, style), index);
+}
+
+void StyledRope::Insert(std::string_view str, StyleId style, uint64_t index) {
+    Insert(StyledSegment(str, style), index);
+}
+
+void StyledRope::Insert(const char* str, StyleId style, uint64_t index) {
+    Insert(StyledSegment(str, style), index);
+}
+
+void StyledRope::Append(const StyledSegment& segment) {
+    root = Merge(root, Build(segment));
+}
+
+void StyledRope::Append(const icu::UnicodeString& str, StyleId style) {
+    Append(StyledSegment(str, style));
+}
+
+void StyledRope::Append(std::string_view str, StyleId style) {
+    Append(StyledSegment(str, style));
+}
+
+void StyledRope::Append(const char* str, StyleId style) {
+    Append(StyledSegment(str, style));
+}
+
+void StyledRope::Erase(uint64_t start, uint64_t end) {
+    if(start >= Len()) throw std::runtime_error("Index of start: " + std::to_string(start) + " is out of bounds << StyledRope::Erase()");
+    if(end >= Len()) throw std::runtime_error("Index of end: " + std::to_string(end) + " is out of bounds << StyledRope::Erase()");
+
+    if(start > end) std::swap(start, end);
+
+    std::pair<uint64_t, uint64_t> front = Split(root, start);
+    std::pair<uint64_t, uint64_t> back = Split(front.second, end - start + 1);
+
+    FreeTree(back.first);
+
+    root = Merge(front.first, back.second);
+}
+
+std::string StyledRope::Write(const StyledSegment& segment, uint64_t index) {
+    if(index >= Len()) throw std::runtime_error("Index " + std::to_string(index) + " is out of bounds << StyledRope::Write()");
+
+    if(segment.Len() == 0) return std::string();
+
+    StyledSegment write_segment(segment);
+    std::string overflow;
+
+    int64_t over = (index + segment.Len()) - Len();
+
+    if(over > 0) {
+        overflow = write_segment.Split(write_segment.Len() - over).Str();
+    }
+
+    Erase(index, index + write_segment.Len() - 1);
+    Insert(write_segment, index);
+
+    return overflow;
+}
+
+std::string StyledRope::Write(const icu::UnicodeString& str, StyleId style, uint64_t index) {
+    return Write(StyledSegment(str, style), index);
+}
+
+std::string StyledRope::Write(std::string_view str, StyleId style, uint64_t index) {
+    return Write(StyledSegment(str, style), index);
+}
+
+std::string StyledRope::Write(const char* str, StyleId style, uint64_t index) {
+    return Write(StyledSegment(str, style), index);
+}
+
+StyledString StyledRope::Substr(uint64_t start, uint64_t end) const {
+    if(start > end) std::swap(start, end);
+
+    if(end >= Len()) throw std::runtime_error("Index of end: " + std::to_string(end) + " is out of bounds << StyledRope::Substr()");
+
+    StyledSegmentArray substr;
+    Collect(root, start, end, substr);
+
+    return StyledString(substr);
+}
+
+void StyledRope::Clear() {
+    pieces.clear();
+    free_pieces.clear();
+
+    root = NIL;
+}
+
+uint64_t StyledRope::Len() const {
+    return SubtreeLen(root);
+}
+
+uint64_t StyledRope::NewPiece(const StyledSegment& segment) {
+    // xorshift, the priorities only have to be random enough to keep the tree balanced
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+
+    Piece piece {segment, NIL, NIL, segment.Len(), seed};
+
+    if(free_pieces.size() > 0) {
+        uint64_t index = free_pieces.back();
+        free_pieces.pop_back();
+
+        pieces[index] = piece;
+        return index;
+    }
+
+    pieces.push_back(piece);
+    return pieces.size() - 1;
+}
+
+void StyledRope::FreeTree(uint64_t piece) {
+    if(piece == NIL) return;
+
+    FreeTree(pieces[piece].left);
+    FreeTree(pieces[piece].right);
+
+    pieces[piece].segment = StyledSegment();
+    free_pieces.push_back(piece);
+}
+
+void StyledRope::Update(uint64_t piece) {
+    pieces[piece].len = SubtreeLen(pieces[piece].left) + pieces[piece].segment.Len() + SubtreeLen(pieces[piece].right);
+}
+
+uint64_t StyledRope::Merge(uint64_t left, uint64_t right) {
+    if(left == NIL) return right;
+    if(right == NIL) return left;
+
+    if(pieces[left].priority > pieces[right].priority) {
+        pieces[left].right = Merge(pieces[left].right, right);
+        Update(left);
+
+        return left;
+    } else {
+        pieces[right].left = Merge(left, pieces[right].left);
+        Update(right);
+
+        return right;
+    }
+}
+
+std::pair<uint64_t, uint64_t> StyledRope::Split(uint64_t piece, uint64_t index) {
+    if(piece == NIL) return {NIL, NIL};
+
+    uint64_t left_len = SubtreeLen(pieces[piece].left);
+    uint64_t piece_end = left_len + pieces[piece].segment.Len();
+
+    if(index <= left_len) {
+        std::pair<uint64_t, uint64_t> halves = Split(pieces[piece].left, index);
+
+        pieces[piece].left = halves.second;
+        Update(piece);
+
+        return {halves.first, piece};
+    }
+
+    if(index >= piece_end) {
+        std::pair<uint64_t, uint64_t> halves = Split(pieces[piece].right, index - piece_end);
+
+        pieces[piece].right = halves.first;
+        Update(piece);
+
+        return {piece, halves.second};
+    }
+
+    // The split point is inside of this piece, the tail becomes the first piece of the right half
+    StyledSegment tail = pieces[piece].segment.Split(index - left_len);
+
+    uint64_t tail_piece = NewPiece(tail);
+    uint64_t right = pieces[piece].right;
+
+    pieces[piece].right = NIL;
+    Update(piece);
+
+    return {piece, Merge(tail_piece, right)};
+}
+
+uint64_t StyledRope::Build(const StyledSegment& segment) {
+    uint64_t tree = NIL;
+
+    if(segment.Len() <= MAX_PIECE_LEN) return segment.Len() > 0 ? NewPiece(segment) : NIL;
+
+    for(uint64_t i = 0; i < segment.Len(); i += MAX_PIECE_LEN) {
+        tree = Merge(tree, NewPiece(segment.Slice(i, MAX_PIECE_LEN)));
+    }
+
+    return tree;
+}
+
+void StyledRope::Collect(uint64_t piece, uint64_t start, uint64_t end, StyledSegmentArray& substr) const {
+    if(piece == NIL) return;
+
+    const Piece& current = pieces[piece];
+
+    uint64_t left_len = SubtreeLen(current.left);
+    uint64_t piece_end = left_len + current.segment.Len();
+
+    if(start < left_len) {
+        Collect(current.left, start, std::min(end, left_len - 1), substr);
+    }
+
+    if(start < piece_end && end >= left_len) {
+        uint64_t from = std::max(start, left_len) - left_len;
+        uint64_t to = std::min(end + 1, piece_end) - left_len;
+
+        // Neighbouring pieces of the same style end up in one segment
+        substr.Append(current.segment.Slice(from, to - from));
+    }
+
+    if(end >= piece_end) {
+        Collect(current.right, std::max(start, piece_end) - piece_end, end - piece_end, substr);
+    }
+}
+
+uint64_t StyledRope::SubtreeLen(uint64_t piece) const {
+    return piece == NIL ? 0 : pieces[piece].len;
+}
+
+} // namespace LibTesix
@@ -1,221 +1,317 @@
 #include "StyledString.h"
 
+#include "Unicode.h"
+
 #include <stdexcept>
 
 namespace LibTesix {
 
-StyledString::StyledString(const icu::UnicodeString& base_string, const Style* style) {
+StyledString::StyledString(const icu::UnicodeString& base_string, StyleId style) {
+    Append(base_string, style);
+    UpdateRaw();
+}
+
+StyledString::StyledString(std::string_view base_string, StyleId style) {
     Append(base_string, style);
     UpdateRaw();
 }
 
-StyledString::StyledString(const char* base_string, const Style* style) {
+StyledString::StyledString(const char* base_string, StyleId style) {
     Append(base_string, style);
     UpdateRaw();
 }
 
-StyledString::StyledString(const StyledSegmentArray& string) {
-    segments = string.segments;
+StyledString::StyledString(const StyledSegmentArray& string) : StyledSegmentArray(string) {
     UpdateRaw();
 }
 
 StyledString::StyledString(const std::vector<StyledSegment>& string) {
-    segments = std::vector<StyledSegment>(string);
+    for(const StyledSegment& segment : string) {
+        StyledSegmentArray::Append(segment);
+    }
+
     UpdateRaw();
 }
 
 StyledString::StyledString() {
-    Append("", style_allocator[0UL]);
+    Append("", STANDARD_STYLE);
     UpdateRaw();
 }
 
-void StyledString::Insert(const icu::UnicodeString& str, const Style* style, uint64_t index) {
+void StyledString::Insert(const StyledSegment& segment, uint64_t index) {
     if(index > Len()) throw std::runtime_error("Index " + std::to_string(index) + " is out of bounds! << StyledString::Insert)");
 
     uint64_t segment_index = GetSegmentIndex(index);
+    uint64_t segment_start = Start(segment_index);
 
-    if(index == segments[segment_index].start) {
-        InsertSegment(StyledSegment(str, style, index), segment_index);
+    if(Segment(segment_index).Len() == 0) {
+        // The empty segment of an empty string is replaced, it would otherwise end up behind the inserted text
+        ReplaceSegment(segment_index, segment);
+    } else if(index == segment_start) {
+        InsertSegment(segment, index, segment_index);
     } else {
-        InsertSegment(segments[segment_index].Split(index - segments[segment_index].start), segment_index + 1);
-        InsertSegment(StyledSegment(str, style, index), segment_index + 1);
+        // Appending to the end of a segment leaves nothing to split off, empty segments would break the ordering of the starts
+        if(index < segment_start + Segment(segment_index).Len()) {
+            SplitSegment(segment_index, index - segment_start);
+        }
+
+        InsertSegment(segment, index, segment_index + 1);
+        segment_index++;
     }
 
-    UpdateSegmentStart(segment_index);
+    // Everything after the inserted segment moves back by its length
+    Shift(segment_index + 1, segment.Len());
+
+    Coalesce(segment_index);
+}
+
+void StyledString::Insert(const icu::UnicodeString& str, StyleId style, uint64_t index) {
+    Insert(StyledSegment(str, style), index);
 }
 
-void StyledString::Insert(const char* str, const Style* style, uint64_t index) {
-    icu::UnicodeString uc_str(str);
-    Insert(uc_str, style, index);
+void StyledString::Insert(std::string_view str, StyleId style, uint64_t index) {
+    Insert(StyledSegment(str, style), index);
 }
 
-void StyledString::Append(const icu::UnicodeString& str, const Style* style) {
-    if(segments.size() == 1 && Len() == 0) {
-        segments[0] = StyledSegment(str, style, 0);
+void StyledString::Insert(const char* str, StyleId style, uint64_t index) {
+    Insert(StyledSegment(str, style), index);
+}
+
+void StyledString::Append(const StyledSegment& segment) {
+    if(SegmentCount() == 1 && Len() == 0) {
+        ReplaceSegment(0, segment);
     } else {
-        StyledSegmentArray::Append(str, style);
+        StyledSegmentArray::Append(segment);
     }
 }
 
-void StyledString::Append(const char* str, const Style* style) {
-    icu::UnicodeString uc_str(str);
-    Append(uc_str, style);
+void StyledString::Append(const icu::UnicodeString& str, StyleId style) {
+    Append(StyledSegment(str, style));
+}
+
+void StyledString::Append(std::string_view str, StyleId style) {
+    Append(StyledSegment(str, style));
+}
+
+void StyledString::Append(const char* str, StyleId style) {
+    Append(StyledSegment(str, style));
 }
 
 void StyledString::Erase(uint64_t start, uint64_t end) {
-    uint64_t start_segment_index = GetSegmentIndex(start);
+    if(start > end) std::swap(start, end);
 
     StyledSegmentArray::Erase(start, end);
 
-    UpdateSegmentStart(start_segment_index);
+    // Close the gap left by the erased text, the segments on both sides of it can now be merged
+    uint64_t gap_index = UpperBound(start);
+
+    Shift(gap_index, -static_cast<int64_t>(end - start + 1));
+
+    if(gap_index > 0) Coalesce(gap_index - 1);
 }
 
-icu::UnicodeString StyledString::Write(const icu::UnicodeString& str, const Style* style, uint64_t index) {
+std::string StyledString::Write(const StyledSegmentView& segment, uint64_t index) {
     if(index >= Len()) throw std::runtime_error("Index " + std::to_string(index) + " is out of bounds << StyledString::Write()");
 
-    if(str.length() == 0) return icu::UnicodeString();
+    if(segment.Len() == 0) return std::string();
+
+    uint64_t fit = Len() - index;
 
-    icu::UnicodeString write_string(str);
-    icu::UnicodeString overflow;
+    // Text that fits is added as it is, only the part that overflows is copied out
+    if(segment.Len() <= fit) {
+        Add(segment, index);
+        return std::string();
+    }
 
-    int64_t over = (index + str.length()) - Len();
+    Add(segment.Slice(0, fit), index);
 
-    if(over > 0) {
-        uint64_t overflow_index = write_string.length() - over;
+    return std::string(segment.Slice(fit).Str());
+}
 
-        write_string.extractBetween(overflow_index, write_string.length(), overflow);
-        write_string.remove(overflow_index);
-    }
+std::string StyledString::Write(const icu::UnicodeString& str, StyleId style, uint64_t index) {
+    return Write(StyledSegment(str, style), index);
+}
 
-    Add(write_string, style, index);
+std::string StyledString::Write(std::string_view str, StyleId style, uint64_t index) {
+    // ASCII text doesn't need cluster offsets, so it is written without being copied into a segment first
+    if(AsciiPrefix(str.data(), str.size()) == str.size()) return Write(StyledSegmentView{str, {}, style}, index);
 
-    return overflow;
+    return Write(StyledSegment(str, style), index);
 }
 
-icu::UnicodeString StyledString::Write(const char* str, const Style* style, uint64_t index) {
-    icu::UnicodeString uc_str(str);
-    return Write(uc_str, style, index);
+std::string StyledString::Write(const char* str, StyleId style, uint64_t index) {
+    return Write(std::string_view(str), style, index);
+}
+
+void StyledString::Write(std::span<const StyledSpan> spans) {
+    if(spans.size() == 0) return;
+
+    uint64_t len = Len();
+
+    // The result is merged into a scratch array, so nothing has to be erased or inserted in the middle of the string
+    // It is swapped with the string afterwards, the storage of the old string is then reused by the next call
+    thread_local StyledSegmentArray merged;
+    merged.Clear();
+
+    // Reused for the text of every span and for the parts of segments that are copied
+    thread_local StyledSegment span_segment;
+    thread_local StyledSegment part;
+
+    // Everything in front of pos is already in merged
+    uint64_t pos = 0;
+    uint64_t segment_index = 0;
+
+    auto copy_until = [&](uint64_t end) {
+        while(segment_index < SegmentCount() && pos < end) {
+            StyledSegmentView segment = Segment(segment_index);
+
+            uint64_t segment_start = Start(segment_index);
+            uint64_t segment_end = segment_start + segment.Len();
+
+            uint64_t to = std::min(end, segment_end);
+
+            if(pos <= segment_start && to == segment_end) {
+                merged.Append(segment);
+            } else if(pos < to) {
+                segment.SliceTo(part, pos - segment_start, to - pos);
+                merged.Append(part);
+            }
+
+            pos = std::max(pos, to);
+
+            if(to == segment_end) segment_index++;
+        }
+    };
+
+    for(const StyledSpan& span : spans) {
+        if(span.index >= len) throw std::runtime_error("Index " + std::to_string(span.index) + " is out of bounds << StyledString::Write()");
+        if(span.index < pos) throw std::runtime_error("Span at " + std::to_string(span.index) + " overlaps the span before it << StyledString::Write()");
+
+        span_segment.Assign(span.str, span.style);
+
+        if(span_segment.Len() == 0) continue;
+
+        copy_until(span.index);
+
+        if(span_segment.Len() > len - span.index) {
+            span_segment.View().SliceTo(part, 0, len - span.index);
+            merged.Append(part);
+        } else {
+            merged.Append(span_segment);
+        }
+
+        pos = std::min(span.index + span_segment.Len(), len);
+    }
+
+    copy_until(len);
+
+    std::swap(static_cast<StyledSegmentArray&>(*this), merged);
 }
 
 StyledString StyledString::Substr(uint64_t start, uint64_t end) {
-    std::vector<StyledSegment> substr_segments;
+    StyledSegmentArray substr;
 
     uint64_t start_segment_index = GetSegmentIndex(start);
     uint64_t end_segment_index = GetSegmentIndex(end);
 
     if(start_segment_index == end_segment_index) {
-        icu::UnicodeString segment_substr;
-        uint64_t segment_start = segments[start_segment_index].start;
+        uint64_t segment_start = Start(start_segment_index);
 
-        segments[start_segment_index].str.extractBetween(start - segment_start, end - segment_start + 1, segment_substr);
-        substr_segments.emplace_back(segment_substr, segments[start_segment_index].style, 0);
+        substr.Append(Segment(start_segment_index).Slice(start - segment_start, end - start + 1));
     } else {
-        icu::UnicodeString segment_substr;
-
         // get substring of the start segment
-        // ...and add that to substr_segments
-        uint64_t start_segment_len = segments[start_segment_index].Len();
-        uint64_t start_segment_start = segments[start_segment_index].start;
+        // ...and add that to substr
+        uint64_t start_segment_start = Start(start_segment_index);
 
-        segments[start_segment_index].str.extractBetween(start - start_segment_start, start_segment_len, segment_substr);
-        substr_segments.emplace_back(segment_substr, segments[start_segment_index].style, 0);
+        substr.Append(Segment(start_segment_index).Slice(start - start_segment_start));
 
         // Add every segment between the start segment and the end segment
         for(uint64_t i = start_segment_index + 1; i < end_segment_index; i++) {
-            uint64_t substr_len = substr_segments.back().start + substr_segments.back().Len();
-            substr_segments.emplace_back(segments[i].str, segments[i].style, substr_len);
+            substr.Append(Segment(i));
         }
 
         // get substring of the end segment
-        // ...and add that to substr_segments
-        uint64_t end_segment_start = segments[end_segment_index].start;
-        uint64_t substr_len = substr_segments.back().start + substr_segments.back().Len();
+        // ...and add that to substr
+        uint64_t end_segment_start = Start(end_segment_index);
 
-        segments[end_segment_index].str.extractBetween(0, end - end_segment_start + 1, segment_substr);
-        substr_segments.emplace_back(segment_substr, segments[end_segment_index].style, substr_len);
+        substr.Append(Segment(end_segment_index).Slice(0, end - end_segment_start + 1));
     }
 
-    return StyledString(substr_segments);
+    return StyledString(substr);
 }
 
 void StyledString::Resize(uint64_t size) {
     if(size == Len()) return;
 
     if(size > Len()) {
-        segments.back().str.append(std::string(size - Len(), ' ').c_str());
+        std::string padding(size - Len(), ' ');
+
+        AppendToLast(StyledSegmentView{padding, {}, StyleEnd()});
     } else {
         StyledSegmentArray::Erase(size, Len() - 1);
-        if(segments.size() == 0) {
-            Append("", style_allocator[0UL]);
+        if(SegmentCount() == 0) {
+            Append("", STANDARD_STYLE);
         }
     }
 }
 
-void StyledString::Clear(const Style* style) {
+void StyledString::Clear(StyleId style) {
     StyledSegmentArray::Clear();
 
     Append("", style);
 }
 
-void StyledString::ClearStyle(const Style* style) {
-    icu::UnicodeString new_seg_str;
+void StyledString::ClearStyle(StyleId style) {
+    StyledSegment new_segment;
+    new_segment.style = style;
 
-    for(StyledSegment& segment : segments) {
-        new_seg_str.append(segment.str);
+    for(uint64_t i = 0; i < SegmentCount(); i++) {
+        new_segment.Append(Segment(i));
     }
 
     StyledSegmentArray::Clear();
 
-    Append(new_seg_str, style);
+    Append(new_segment);
 }
 
 void StyledString::UpdateRaw() {
-    std::string new_raw;
+    raw.clear();
+    raw_generation = style_allocator.Generation();
 
-    Style state = *segments[0].style;
+    StyleId state = StyleStart();
 
-    for(StyledSegment& segment : segments) {
-        new_raw.append(segment.style->GetEscapeCode(state));
-        segment.str.toUTF8String(new_raw);
+    for(uint64_t i = 0; i < SegmentCount(); i++) {
+        StyleId style = SegmentStyle(i);
 
-        state = *segment.style;
-    }
+        raw.append(style_allocator.Transition(state, style));
+        raw.append(Segment(i).Str());
 
-    raw = new_raw;
+        state = style;
+    }
 }
 
-std::string StyledString::Raw(const Style& state, bool should_update) {
-    if(should_update) UpdateRaw();
+std::string StyledString::Raw(StyleId state, bool should_update) {
+    if(should_update || raw_generation != style_allocator.Generation()) UpdateRaw();
 
-    return segments[0].style->GetEscapeCode(state) + raw;
+    return std::string(style_allocator.Transition(state, StyleStart())) + raw;
 }
 
-const Style* StyledString::StyleStart() const {
-    return segments[0].style;
+StyleId StyledString::StyleStart() const {
+    return SegmentStyle(0);
 }
 
-const Style* StyledString::StyleEnd() const {
-    return segments.back().style;
+StyleId StyledString::StyleEnd() const {
+    return SegmentStyle(SegmentCount() - 1);
 }
 
-void StyledString::Print(Style& state, bool should_update) {
-    printf(Raw(state).c_str());
-    printf("\n");
+void StyledString::Print(StyleId& state, bool should_update, OutputBuffer& out) {
+    if(should_update || raw_generation != style_allocator.Generation()) UpdateRaw();
 
-    state = *StyleEnd();
-}
+    out.Append(style_allocator.Transition(state, StyleStart()));
+    out.Append(raw);
+    out.Append('\n');
 
-void StyledString::UpdateSegmentStart(uint64_t index) {
-    uint64_t next_start = 0;
-    if(index > 0) {
-        next_start = segments[index - 1].start + segments[index - 1].Len();
-    }
-
-    for(uint64_t i = index; i < segments.size(); i++) {
-        segments[i].start = next_start;
-
-        next_start = segments[i].start + segments[i].Len();
-    }
+    state = StyleEnd();
 }
 
 } // namespace LibTesix
\ No newline at end of file
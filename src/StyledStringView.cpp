@@ -0,0 +1,102 @@
+#include "StyledStringView.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace LibTesix {
+
+StyledStringView::StyledStringView(const StyledString& str, uint64_t start, uint64_t end) {
+    this->str = &str;
+    this->end = std::min(end, str.Len());
+    this->start = std::min(start, this->end);
+}
+
+uint64_t StyledStringView::Len() const {
+    return end - start;
+}
+
+void StyledStringView::Serialize(std::string& out, StyleId& start_style, StyleId& end_style, const StyledSegmentArray* overlay) const {
+    if(overlay == nullptr) {
+        Serialize(out, start_style, end_style, std::span<const StyledSegmentArray* const>());
+    } else {
+        Serialize(out, start_style, end_style, std::span<const StyledSegmentArray* const>(&overlay, 1));
+    }
+}
+
+void StyledStringView::Serialize(
+    std::string& out, StyleId& start_style, StyleId& end_style, std::span<const StyledSegmentArray* const> layers) const {
+    StyleId state = NO_STYLE;
+    start_style = NO_STYLE;
+
+    // The segment of every layer that is at or after the current column, kept between rows so they don't allocate
+    thread_local std::vector<uint64_t> cursors;
+    cursors.resize(layers.size());
+
+    for(uint64_t k = 0; k < layers.size(); k++) {
+        cursors[k] = layers[k]->GetSegmentIndex(start);
+    }
+
+    for(uint64_t pos = start; pos < end;) {
+        const StyledSegmentArray* top = str;
+        uint64_t run_end = end;
+
+        // The first layer from the top that covers pos is drawn until a higher layer starts a segment
+        for(uint64_t k = layers.size(); k-- > 0;) {
+            const StyledSegmentArray& layer = *layers[k];
+            uint64_t& cursor = cursors[k];
+
+            while(cursor < layer.SegmentCount() && layer.Start(cursor) + layer.SegmentLen(cursor) <= pos) {
+                cursor++;
+            }
+
+            if(cursor == layer.SegmentCount()) continue;
+
+            uint64_t segment_start = layer.Start(cursor);
+
+            if(segment_start <= pos) {
+                top = &layer;
+                run_end = std::min(run_end, segment_start + layer.SegmentLen(cursor));
+                break;
+            }
+
+            run_end = std::min(run_end, segment_start);
+        }
+
+        SerializeRange(*top, pos, run_end, out, state, start_style);
+
+        pos = run_end;
+    }
+
+    // An empty view doesn't change the style
+    if(start_style == NO_STYLE) start_style = state = str->StyleStart();
+
+    end_style = state;
+}
+
+void StyledStringView::SerializeRange(
+    const StyledSegmentArray& arr, uint64_t start, uint64_t end, std::string& out, StyleId& state, StyleId& start_style) const {
+    if(start >= end) return;
+
+    for(uint64_t i = arr.GetSegmentIndex(start); i < arr.SegmentCount(); i++) {
+        StyledSegmentView seg = arr.Segment(i);
+
+        uint64_t seg_start = arr.Start(i);
+        uint64_t from = std::max(start, seg_start);
+        uint64_t to = std::min(end, seg_start + seg.Len());
+
+        if(from >= end) break;
+        if(from >= to) continue;
+
+        if(start_style == NO_STYLE) {
+            start_style = seg.style;
+            state = seg.style;
+        } else if(seg.style != state) {
+            out.append(style_allocator.Transition(state, seg.style));
+            state = seg.style;
+        }
+
+        seg.AppendTo(out, from - seg_start, to - from);
+    }
+}
+
+} // namespace LibTesix
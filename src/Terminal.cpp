@@ -1,16 +1,51 @@
 #include "Terminal.h"
 
+#include <atomic>
 #include <csignal>
+#include <map>
 #include <stdexcept>
 #include <sys/ioctl.h>
 
 termios attr;
 namespace LibTesix {
 
+// The size of the terminal with the width in the upper and the height in the lower 32 bits, 0 until InitScreen is called
+std::atomic<uint64_t> terminal_size = 0;
+std::atomic<bool> terminal_resized = false;
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "The terminal size has to be lock free to be set by a signal handler");
+
+std::map<uint64_t, std::function<void(uint64_t, uint64_t)>> resize_callbacks;
+uint64_t next_resize_callback_id = 0;
+
+uint64_t QueryTerminalSize() {
+    struct winsize w {};
+    ioctl(STDOUT_FILENO, TIOCGWINSZ, &w);
+
+    return (static_cast<uint64_t>(w.ws_col) << 32) | w.ws_row;
+}
+
+uint64_t TerminalSize() {
+    uint64_t size = terminal_size.load(std::memory_order_relaxed);
+
+    // Without InitScreen there is no signal handler to keep the cache up to date
+    if(size == 0) return QueryTerminalSize();
+
+    return size;
+}
+
 int InitScreen() {
     std::signal(SIGINT, Interupt);
     std::atexit(Exit);
 
+    terminal_size.store(QueryTerminalSize());
+
+    struct sigaction resize_action {};
+    resize_action.sa_handler = Resized;
+    resize_action.sa_flags = SA_RESTART;
+    sigemptyset(&resize_action.sa_mask);
+    sigaction(SIGWINCH, &resize_action, nullptr);
+
     tcgetattr(STDIN, &attr);
 
     termios new_attr = attr;
@@ -21,52 +56,81 @@ int InitScreen() {
     // setbuf(stdin, NULL);
 
     system("clear");
-    printf("\033[2J\033[0;0f\033[38;2;255;255;255m\033[48;2;0;0;0m\n");
+
+    output.Append("\033[2J\033[0;0f\033[38;2;255;255;255m\033[48;2;0;0;0m");
+    output.Flush();
 
     return 0;
 }
 
 void Interupt(int signal) {
-    printf("\033[0m\033[2J\n\033[0;0f");
+    // The output buffer may be in the middle of an append, so this writes directly
+    const char reset[] = "\033[0m\033[2J\n\033[0;0f";
+    write(STDOUT_FILENO, reset, sizeof(reset) - 1);
     tcsetattr(STDIN, TCSANOW, &attr);
     exit(signal);
 }
 
 void Exit() {
-    printf("\033[0m\033[2J\n\033[0;0f");
+    output.Append("\033[0m\033[2J\n\033[0;0f");
+    output.Flush();
     tcsetattr(STDIN, TCSANOW, &attr);
 }
 
-void Clear(const Style* style) {
-    printf(style->GetEscapeCode(state).c_str());
-    state = *style;
-    printf("\033[2J\033[0;0f\n");
+void Resized(int) {
+    terminal_size.store(QueryTerminalSize(), std::memory_order_relaxed);
+    terminal_resized.store(true);
 }
 
-void Update() {
-    printf("\033[0;0f\n");
+void Clear(StyleId style, OutputBuffer& out) {
+    out.Append(style_allocator.Transition(state, style));
+    state = style;
+    out.Append("\033[2J\033[0;0f");
 }
 
-uint64_t GetTerminalWidth() {
-    struct winsize w;
-    ioctl(STDOUT_FILENO, TIOCGWINSZ, &w);
+void Update(OutputBuffer& out) {
+    out.Append("\033[0;0f");
+    out.Flush();
+
+    HandleResize();
+}
 
+uint64_t GetTerminalWidth() {
 #ifdef TTY_SIZE_OVERRIDE
     return 211;
 #else
-    return w.ws_col;
+    return TerminalSize() >> 32;
 #endif
 }
 
 uint64_t GetTerminalHeight() {
-    struct winsize w;
-    ioctl(STDOUT_FILENO, TIOCGWINSZ, &w);
-
 #ifdef TTY_SIZE_OVERRIDE
     return 49;
 #else
-    return w.ws_row;
+    return TerminalSize() & UINT32_MAX;
 #endif
 }
 
+uint64_t AddResizeCallback(std::function<void(uint64_t width, uint64_t height)> callback) {
+    resize_callbacks[next_resize_callback_id] = callback;
+    return next_resize_callback_id++;
+}
+
+void RemoveResizeCallback(uint64_t id) {
+    resize_callbacks.erase(id);
+}
+
+bool HandleResize() {
+    if(!terminal_resized.exchange(false)) return false;
+
+    uint64_t width = GetTerminalWidth();
+    uint64_t height = GetTerminalHeight();
+
+    for(auto& [id, callback] : resize_callbacks) {
+        callback(width, height);
+    }
+
+    return true;
+}
+
 } // namespace LibTesix
\ No newline at end of file
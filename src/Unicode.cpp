@@ -0,0 +1,121 @@
+#include "Unicode.h"
+
+#include <cstring>
+#include <memory>
+#include <unicode/brkiter.h>
+#include <unicode/uchar.h>
+#include <unicode/utext.h>
+#include <unicode/utf8.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace LibTesix {
+
+uint64_t AsciiPrefix(const char* data, uint64_t len) {
+    uint64_t i = 0;
+
+#ifdef __SSE2__
+    for(; i + 16 <= len; i += 16) {
+        int mask = _mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i)));
+
+        if(mask != 0) return i + __builtin_ctz(mask);
+    }
+#endif
+
+    // Eight bytes at a time, the exact position is found byte by byte below
+    for(; i + 8 <= len; i += 8) {
+        uint64_t word;
+        std::memcpy(&word, data + i, 8);
+
+        if(word & 0x8080808080808080) break;
+    }
+
+    while(i < len && static_cast<uint8_t>(data[i]) < 0x80) {
+        i++;
+    }
+
+    return i;
+}
+
+uint64_t ClusterWidth(std::string_view cluster) {
+    int32_t i = 0;
+    int32_t len = cluster.size();
+
+    UChar32 c;
+    U8_NEXT(cluster.data(), i, len, c);
+
+    if(c < 0) return 1;
+
+    int8_t category = u_charType(c);
+    if(category == U_NON_SPACING_MARK || category == U_ENCLOSING_MARK || category == U_FORMAT_CHAR) return 0;
+
+    int32_t east_asian_width = u_getIntPropertyValue(c, UCHAR_EAST_ASIAN_WIDTH);
+    if(east_asian_width == U_EA_WIDE || east_asian_width == U_EA_FULLWIDTH) return 2;
+
+    if(u_hasBinaryProperty(c, UCHAR_EMOJI_PRESENTATION)) return 2;
+
+    // Variation selector 16 turns the cluster into an emoji
+    while(i < len) {
+        U8_NEXT(cluster.data(), i, len, c);
+
+        if(c == 0xFE0F) return 2;
+    }
+
+    return 1;
+}
+
+// Creating a break iterator loads its rules, so one is kept per thread
+struct ClusterIterator {
+    ClusterIterator() {
+        UErrorCode status = U_ZERO_ERROR;
+        iterator.reset(icu::BreakIterator::createCharacterInstance(icu::Locale::getRoot(), status));
+    }
+
+    ~ClusterIterator() {
+        utext_close(&text);
+    }
+
+    std::unique_ptr<icu::BreakIterator> iterator;
+    UText text = UTEXT_INITIALIZER;
+};
+
+void IndexColumns(std::string_view str, uint64_t from, std::vector<uint32_t>& offsets) {
+    thread_local ClusterIterator clusters;
+
+    bool text_set = false;
+    uint64_t i = from;
+
+    while(i < str.size()) {
+        // ASCII followed by ASCII is a cluster of its own, only the rest needs the break iterator
+        if(static_cast<uint8_t>(str[i]) < 0x80 && (i + 1 == str.size() || static_cast<uint8_t>(str[i + 1]) < 0x80)) {
+            offsets.push_back(i);
+            i++;
+            continue;
+        }
+
+        if(!text_set) {
+            UErrorCode status = U_ZERO_ERROR;
+            utext_openUTF8(&clusters.text, str.data(), str.size(), &status);
+            clusters.iterator->setText(&clusters.text, status);
+
+            text_set = true;
+        }
+
+        int32_t end = clusters.iterator->following(i);
+        if(end == icu::BreakIterator::DONE) end = str.size();
+
+        uint64_t width = ClusterWidth(str.substr(i, end - i));
+
+        if(width == 0 && offsets.size() == 0) width = 1;
+
+        for(uint64_t j = 0; j < width; j++) {
+            offsets.push_back(i);
+        }
+
+        i = end;
+    }
+}
+
+} // namespace LibTesix
@@ -2,13 +2,23 @@
 
 #include "Terminal.h"
 
+#include <algorithm>
+#include <charconv>
 #include <iostream>
 #include <sys/ioctl.h>
 #include <unistd.h>
 
 namespace LibTesix {
 
-Window::Window(int64_t x, int64_t y, uint64_t width, uint64_t height, const Style* style) {
+// Appends num without building a temporary string
+static void AppendNumber(std::string& str, uint64_t num) {
+    char digits[20];
+    char* end = std::to_chars(digits, digits + sizeof(digits), num).ptr;
+
+    str.append(digits, end - digits);
+}
+
+Window::Window(int64_t x, int64_t y, uint64_t width, uint64_t height, StyleId style) {
     this->x = x;
     this->y = y;
     this->width = width;
@@ -19,83 +29,290 @@ Window::Window(int64_t x, int64_t y, uint64_t width, uint64_t height, const Styl
     fill.ClearStyle(style);
 
     lines.resize(height, fill);
+    clear_style = style;
+
+    Damage(Bounds());
 }
 
 Window::Window(JsonDocument& json, const char* name) {
     LoadFromJson(json, name);
+    Damage(Bounds());
 }
 
 Window::Window(JsonDocument& json, rapidjson::Value& json_window) {
     LoadFromJson(json, json_window);
+    Damage(Bounds());
+}
+
+Window::~Window() {
+    ReleaseOutput();
 }
 
-void Window::Write(uint64_t col, uint64_t line, icu::UnicodeString& str, const Style* style) {
+void Window::Write(uint64_t col, uint64_t line, std::string_view str, StyleId style) {
     if(col >= width) throw std::runtime_error("x: " + std::to_string(x) + " is out of bounds! << Window::Print()");
     else if(line >= height)
         throw std::runtime_error("y: " + std::to_string(y) + " is out of bounds! << Window::Print()");
 
-    icu::UnicodeString overflow;
+    std::string overflow;
 
-    overflow = lines[line].Write(str, style, col);
+    // A column takes at least one byte, so the length of the text in bytes bounds the written columns
+    Damage(Rect{x + static_cast<int64_t>(col), y + static_cast<int64_t>(line), std::min<uint64_t>(str.size(), width - col), 1});
+
+    overflow = Line(line).Write(str, style, col);
+    MarkDirty(line);
     line++;
-    while(!overflow.isEmpty() && line < height) {
-        overflow = lines[line].Write(overflow, style, 0);
+    while(!overflow.empty() && line < height) {
+        Damage(Rect{x, y + static_cast<int64_t>(line), std::min<uint64_t>(overflow.size(), width), 1});
+
+        overflow = Line(line).Write(overflow, style, 0);
+        MarkDirty(line);
         line++;
     }
 }
 
-void Window::Write(uint64_t col, uint64_t line, const char* str, const Style* style) {
-    icu::UnicodeString uc_str(str);
+void Window::Write(uint64_t col, uint64_t line, const icu::UnicodeString& str, StyleId style) {
+    std::string utf8;
+    str.toUTF8String(utf8);
+
+    Write(col, line, utf8, style);
+}
+
+void Window::Write(uint64_t col, uint64_t line, const char* str, StyleId style) {
+    Write(col, line, std::string_view(str), style);
+}
+
+void Window::Write(std::span<const WindowSpan> spans) {
+    for(uint64_t i = 0; i < spans.size();) {
+        uint64_t line = spans[i].line;
+
+        if(line >= height) throw std::runtime_error("y: " + std::to_string(line) + " is out of bounds! << Window::Write()");
+
+        line_spans.clear();
+
+        for(; i < spans.size() && spans[i].line == line; i++) {
+            if(spans[i].col >= width) throw std::runtime_error("x: " + std::to_string(spans[i].col) + " is out of bounds! << Window::Write()");
+
+            line_spans.push_back(StyledSpan{spans[i].col, spans[i].str, spans[i].style});
+
+            Damage(Rect{x + static_cast<int64_t>(spans[i].col), y + static_cast<int64_t>(line),
+                std::min<uint64_t>(spans[i].str.size(), width - spans[i].col), 1});
+        }
 
-    Write(col, line, uc_str, style);
+        Line(line).Write(line_spans);
+        MarkDirty(line);
+    }
 }
 
 void Window::UpdateRaw() {
+    raw.clear();
+    drawn_lines.clear();
+    raw_start_style = NO_STYLE;
+
     if(lines.size() == 0) {
-        raw = "";
         return;
     }
 
-    std::string new_raw;
+    uint64_t terminal_width = GetTerminalWidth();
+    uint64_t terminal_height = GetTerminalHeight();
 
-    Range x_visible = ClampRange(GetTerminalWidth(), Range(x, x + width));
-    Range y_visible = ClampRange(GetTerminalHeight(), Range(y, y + height));
+    // Lines serialized before a style was changed still contain its old escape codes
+    if(terminal_width != raw_terminal_width || terminal_height != raw_terminal_height || style_allocator.Generation() != raw_style_generation) {
+        raw_terminal_width = terminal_width;
+        raw_terminal_height = terminal_height;
+        raw_style_generation = style_allocator.Generation();
+        MarkDirty();
+    }
+
+    Range x_visible = ClampRange(terminal_width, Range(x, x + width));
+    Range y_visible = ClampRange(terminal_height, Range(y, y + height));
 
     if((x_visible.first == -1 && x_visible.second == -1) || (y_visible.first == -1 && y_visible.second == -1)) {
-        raw = "";
+        raw_complete = false;
+        pending_scroll = 0;
         return;
     }
 
-    Style state = *lines[y_visible.first].StyleStart();
-    raw_start_style = lines[y_visible.first].StyleStart();
+    if(raw_lines.size() != lines.size()) {
+        ReleaseOutput();
+        raw_lines.resize(lines.size());
+        raw_complete = false;
+    }
 
     uint64_t clipped_x;
     clipped_x = x * (x > 0);
 
+    // Only the lines that changed have to be drawn after the terminal itself scrolled the rest
+    bool scroll = pending_scroll != 0 && raw_complete && x <= 0 && x + static_cast<int64_t>(width) >= static_cast<int64_t>(terminal_width) &&
+        y >= 0 && y + height <= terminal_height;
+
+    if(scroll) {
+        raw.append("\033[");
+        AppendNumber(raw, y + 1);
+        raw.push_back(';');
+        AppendNumber(raw, y + height);
+        raw.push_back('r');
+
+        raw.append("\033[");
+        AppendNumber(raw, std::abs(pending_scroll));
+        raw.push_back(pending_scroll > 0 ? 'S' : 'T');
+
+        raw.append("\033[r");
+    }
+
+    pending_scroll = 0;
+
+    StyleId state = NO_STYLE;
+
     for(uint64_t i = y_visible.first; i < y_visible.second; i++) {
-        new_raw.append("\033[" + std::to_string(y + i + 1) + ";" + std::to_string(clipped_x + 1) + "f");
+        RawLine& line = raw_lines[LineIndex(i)];
+
+        bool stale = line.dirty || line.clip != x_visible;
+
+        if(!stale && scroll) continue;
+
+        if(stale) SerializeLine(i, x_visible);
+
+        raw.append("\033[");
+        AppendNumber(raw, y + i + 1);
+        raw.push_back(';');
+        AppendNumber(raw, clipped_x + 1);
+        raw.push_back('f');
 
-        StyledString visible = lines[i].Substr(x_visible.first, x_visible.second);
-        if(overlay_enabled && i < overlay.height) ApplySegmentArray(overlay.lines[i], visible, x_visible.first);
+        // Lines are serialized on their own, the change from the end of the previous line has to be added in between
+        if(state != NO_STYLE) raw.append(style_allocator.Transition(state, line.start_style));
+        drawn_lines.push_back(DrawnLine{raw.size(), LineIndex(i)});
+
+        if(raw_start_style == NO_STYLE) raw_start_style = line.start_style;
+        state = line.end_style;
+    }
+
+    raw_end_style = state;
+    raw_complete = true;
+
+    // Everything that changed was drawn
+    damage.clear();
+}
+
+void Window::SerializeLine(uint64_t line, Range x_visible) {
+    RawLine& raw_line = raw_lines[LineIndex(line)];
+
+    // The output still holds the old bytes of the line
+    if(raw_line.referenced == reference_epoch) ReleaseOutput();
+
+    // Serialized straight from the line, the layers are composited on the way
+    StyledStringView visible(Line(line), x_visible.first, x_visible.second + 1);
+
+    raw_line.raw.clear();
+    visible.Serialize(raw_line.raw, raw_line.start_style, raw_line.end_style, LineLayers(line));
+
+    raw_line.clip = x_visible;
+    raw_line.dirty = false;
+}
 
-        new_raw.append(visible.Raw(state, 0));
-        state = *visible.StyleEnd();
+std::span<const StyledSegmentArray* const> Window::LineLayers(uint64_t line) {
+    line_layers.clear();
 
-        raw_end_style = visible.StyleEnd();
+    for(const Layer& layer : layers) {
+        if(layer.visible && line < layer.overlay.lines.size()) line_layers.push_back(&layer.overlay.lines[line]);
     }
 
-    raw = new_raw;
+    return line_layers;
 }
 
-void Window::Draw(Style& state, bool should_update) {
+void Window::DrawLine(uint64_t line, uint64_t start, uint64_t end, StyleId& state, OutputBuffer& out) {
+    if(line >= height) throw std::runtime_error("y: " + std::to_string(line) + " is out of bounds! << Window::DrawLine()");
+
+    end = std::min(end, width);
+
+    if(start >= end) return;
+
+    // Drawing single lines leaves the terminal in a state the scroll of Draw can't build on
+    pending_scroll = 0;
+    raw_complete = false;
+
+    if(raw_lines.size() != lines.size()) {
+        ReleaseOutput();
+        raw_lines.resize(lines.size());
+    }
+
+    if(style_allocator.Generation() != raw_style_generation) {
+        raw_style_generation = style_allocator.Generation();
+
+        for(RawLine& raw_line : raw_lines) {
+            raw_line.dirty = true;
+        }
+    }
+
+    Range x_visible = ClampRange(GetTerminalWidth(), Range(x, x + width));
+
+    out.MoveCursor(x + start, y + line);
+
+    if(static_cast<int64_t>(start) == x_visible.first && end == std::min<uint64_t>(x_visible.second + 1, width)) {
+        // The whole visible part of the line is drawn from the cache
+        RawLine& raw_line = raw_lines[LineIndex(line)];
+
+        if(raw_line.dirty || raw_line.clip != x_visible) SerializeLine(line, x_visible);
+
+        Reference(out);
+
+        out.Append(style_allocator.Transition(state, raw_line.start_style));
+        out.AppendRef(raw_line.raw);
+        raw_line.referenced = reference_epoch;
+
+        state = raw_line.end_style;
+    } else {
+        // Partly covered lines are serialized for this draw only
+        thread_local std::string partial;
+        partial.clear();
+
+        StyleId start_style;
+        StyleId end_style;
+
+        StyledStringView(Line(line), start, end).Serialize(partial, start_style, end_style, LineLayers(line));
+
+        out.Append(style_allocator.Transition(state, start_style));
+        out.Append(partial);
+
+        state = end_style;
+    }
+}
+
+void Window::Draw(StyleId& state, bool should_update, OutputBuffer& out) {
     if(should_update) {
         UpdateRaw();
     }
 
-    printf(raw_start_style->GetEscapeCode(state).c_str());
-    printf(raw.c_str());
+    if(raw_start_style == NO_STYLE) return;
+
+    Reference(out);
+
+    out.Append(style_allocator.Transition(state, raw_start_style));
+
+    // The lines are handed to out where they are cached, only the short codes in between are copied
+    std::string_view codes(raw);
+    uint64_t offset = 0;
+
+    for(const DrawnLine& drawn : drawn_lines) {
+        out.Append(codes.substr(offset, drawn.offset - offset));
+        out.AppendRef(raw_lines[drawn.line_index].raw);
+        raw_lines[drawn.line_index].referenced = reference_epoch;
+
+        offset = drawn.offset;
+    }
+
+    out.Append(codes.substr(offset));
 
-    state = *raw_end_style;
+    state = raw_end_style;
+}
+
+void Window::Draw(Screen& screen) {
+    for(uint64_t i = 0; i < lines.size(); i++) {
+        screen.Write(x, y + i, Line(i), width);
+
+        for(const Layer& layer : layers) {
+            if(layer.visible && i < layer.overlay.lines.size()) screen.Write(x, y + i, layer.overlay.lines[i], width);
+        }
+    }
 }
 
 uint64_t Window::GetHeight() {
@@ -115,11 +332,25 @@ int64_t Window::GetY() {
 }
 
 void Window::Move(int64_t x, int64_t y) {
+    // The lines are drawn at a new position, UpdateRaw only serializes the lines again whose clipping changed
+    if(x == this->x && y == this->y) return;
+
+    raw_complete = false;
+
+    // What was below the old position is exposed
+    Damage(Bounds());
+
     this->x = x;
     this->y = y;
+
+    Damage(Bounds());
 }
 
 void Window::Resize(uint64_t width, uint64_t height) {
+    Unroll();
+
+    Damage(Bounds());
+
     lines.resize(height);
 
     for(StyledString& str : lines) {
@@ -128,27 +359,237 @@ void Window::Resize(uint64_t width, uint64_t height) {
 
     this->width = width;
     this->height = height;
+
+    MarkDirty();
+}
+
+void Window::Scroll(int64_t n) {
+    if(lines.size() == 0 || n == 0) return;
+
+    if(static_cast<uint64_t>(std::abs(n)) >= lines.size()) {
+        Clear(clear_style);
+        return;
+    }
+
+    uint64_t exposed_start;
+
+    if(n > 0) {
+        first_line = (first_line + n) % lines.size();
+        exposed_start = lines.size() - n;
+    } else {
+        first_line = (first_line + lines.size() + n) % lines.size();
+        exposed_start = 0;
+    }
+
+    for(uint64_t i = exposed_start; i < exposed_start + std::abs(n); i++) {
+        Line(i).Clear(clear_style);
+        Line(i).Resize(width);
+        MarkDirty(i);
+    }
+
+    // Every line is shown at a new position
+    Damage(Bounds());
+
+    // The layers stay at their rows while the lines move below them, every line has to be composited again and the terminal can't just
+    // scroll what it shows
+    if(std::any_of(layers.begin(), layers.end(), [](const Layer& layer) { return layer.visible; })) {
+        MarkDirty();
+        pending_scroll = 0;
+        return;
+    }
+
+    pending_scroll += n;
 }
 
 void Window::ApplyOverlay(Overlay& overlay) {
-    this->overlay = Overlay(overlay);
-    overlay_enabled = true;
-    has_overlay = true;
+    for(Layer& layer : layers) {
+        if(layer.id == OVERLAY_LAYER) {
+            layer.overlay = overlay;
+            layer.visible = true;
+
+            MarkDirty();
+            return;
+        }
+    }
+
+    layers.push_back(Layer{OVERLAY_LAYER, 0, next_layer_order++, true, overlay});
+    SortLayers();
+
+    MarkDirty();
 }
 
 void Window::ApplyOverlay() {
-    overlay_enabled = true;
+    for(Layer& layer : layers) {
+        if(layer.id == OVERLAY_LAYER) ShowLayer(OVERLAY_LAYER, true);
+    }
 }
 
 void Window::RemoveOverlay() {
-    overlay_enabled = false;
+    for(Layer& layer : layers) {
+        if(layer.id == OVERLAY_LAYER) ShowLayer(OVERLAY_LAYER, false);
+    }
 }
 
-void Window::Clear(const Style* style) {
+uint64_t Window::AddLayer(const Overlay& overlay, int64_t z) {
+    uint64_t id = next_layer_id++;
+
+    layers.push_back(Layer{id, z, next_layer_order++, true, overlay});
+    SortLayers();
+
+    MarkDirty();
+
+    return id;
+}
+
+void Window::RemoveLayer(uint64_t id) {
+    Layer& layer = FindLayer(id, "RemoveLayer");
+
+    layers.erase(layers.begin() + (&layer - layers.data()));
+
+    MarkDirty();
+}
+
+Overlay& Window::GetLayer(uint64_t id) {
+    Layer& layer = FindLayer(id, "GetLayer");
+
+    MarkDirty();
+
+    return layer.overlay;
+}
+
+void Window::SetLayerZ(uint64_t id, int64_t z) {
+    Layer& layer = FindLayer(id, "SetLayerZ");
+
+    if(layer.z == z) return;
+
+    layer.z = z;
+    SortLayers();
+
+    MarkDirty();
+}
+
+void Window::ShowLayer(uint64_t id, bool visible) {
+    Layer& layer = FindLayer(id, "ShowLayer");
+
+    if(layer.visible == visible) return;
+
+    layer.visible = visible;
+
+    MarkDirty();
+}
+
+Window::Layer& Window::FindLayer(uint64_t id, const char* caller) {
+    for(Layer& layer : layers) {
+        if(layer.id == id) return layer;
+    }
+
+    throw std::runtime_error("Layer " + std::to_string(id) + " doesn't exist! << Window::" + caller + "()");
+}
+
+void Window::SortLayers() {
+    // Sorting by z alone would keep the order layers had before their z changed
+    std::sort(layers.begin(), layers.end(), [](const Layer& a, const Layer& b) { return a.z != b.z ? a.z < b.z : a.order < b.order; });
+}
+
+void Window::Clear(StyleId style) {
+    clear_style = style;
+
     for(StyledString& str : lines) {
         str.Clear(style);
         str.Resize(width);
     }
+
+    MarkDirty();
+}
+
+void Window::MarkDirty() {
+    for(RawLine& line : raw_lines) {
+        line.dirty = true;
+    }
+
+    raw_complete = false;
+
+    Damage(Bounds());
+}
+
+void Window::MarkDirty(uint64_t line) {
+    if(line < raw_lines.size()) raw_lines[LineIndex(line)].dirty = true;
+}
+
+uint64_t Window::LineIndex(uint64_t line) const {
+    return (first_line + line) % lines.size();
+}
+
+StyledString& Window::Line(uint64_t line) {
+    return lines[LineIndex(line)];
+}
+
+Rect Window::Bounds() const {
+    return Rect{x, y, width, height};
+}
+
+const std::vector<Rect>& Window::GetDamage() const {
+    return damage;
+}
+
+void Window::ClearDamage() {
+    damage.clear();
+}
+
+void Window::Damage(const Rect& rect) {
+    if(rect.width == 0 || rect.height == 0) return;
+
+    damage.push_back(rect);
+
+    // Many small rects are merged into their bounding box, which keeps windows that are never asked for their damage from growing
+    if(damage.size() > MAX_DAMAGE_RECTS) {
+        int64_t left = damage[0].x;
+        int64_t top = damage[0].y;
+        int64_t right = damage[0].x + damage[0].width;
+        int64_t bottom = damage[0].y + damage[0].height;
+
+        for(const Rect& r : damage) {
+            left = std::min(left, r.x);
+            top = std::min(top, r.y);
+            right = std::max<int64_t>(right, r.x + r.width);
+            bottom = std::max<int64_t>(bottom, r.y + r.height);
+        }
+
+        damage.assign(1, Rect{left, top, static_cast<uint64_t>(right - left), static_cast<uint64_t>(bottom - top)});
+    }
+}
+
+void Window::ReleaseOutput() {
+    std::shared_ptr<OutputBuffer*> out = referencing_output.lock();
+
+    // A destroyed output doesn't reference anything anymore
+    if(out != nullptr && (*out)->Frame() == referencing_frame) (*out)->CopyReferences();
+
+    referencing_output.reset();
+    reference_epoch++;
+}
+
+void Window::Reference(OutputBuffer& out) {
+    std::shared_ptr<OutputBuffer*> handle = referencing_output.lock();
+
+    if(handle != nullptr && *handle == &out && out.Frame() == referencing_frame) return;
+
+    ReleaseOutput();
+
+    referencing_output = out.Handle();
+    referencing_frame = out.Frame();
+}
+
+void Window::Unroll() {
+    ReleaseOutput();
+
+    std::rotate(lines.begin(), lines.begin() + first_line, lines.end());
+
+    if(raw_lines.size() == lines.size()) {
+        std::rotate(raw_lines.begin(), raw_lines.begin() + first_line, raw_lines.end());
+    }
+
+    first_line = 0;
 }
 
 Range ClampRange(uint64_t max, Range range) {
@@ -187,16 +628,18 @@ Range ClampRange(uint64_t max, Range range) {
 }
 
 void ApplySegmentArray(StyledSegmentArray& arr, StyledString& str, uint64_t offset) {
-    for(StyledSegment seg : arr.segments) {
-        if(seg.start >= offset + str.Len()) {
+    for(uint64_t i = 0; i < arr.SegmentCount(); i++) {
+        StyledSegmentView seg = arr.Segment(i);
+        uint64_t seg_start = arr.Start(i);
+
+        if(seg_start >= offset + str.Len()) {
             break;
         }
 
-        if(seg.start < offset && seg.start + seg.Len() > offset) {
-            icu::UnicodeString segment_substr(seg.str, offset, seg.Len() - offset);
-            str.Write(segment_substr, seg.style, 0);
-        } else if(seg.start >= offset) {
-            str.Write(seg.str, seg.style, seg.start - offset);
+        if(seg_start < offset && seg_start + seg.Len() > offset) {
+            str.Write(seg.Slice(offset - seg_start), 0);
+        } else if(seg_start >= offset) {
+            str.Write(seg, seg_start - offset);
         }
     }
 
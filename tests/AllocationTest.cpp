@@ -0,0 +1,99 @@
+#include "StyledString.h"
+#include "Window.h"
+
+#include "Test.h"
+
+#include <new>
+
+using namespace LibTesix;
+
+// Counts every allocation made through operator new, for all tests as they share one executable
+static uint64_t allocations = 0;
+
+void* operator new(std::size_t size) {
+    allocations++;
+
+    if(void* ptr = std::malloc(size == 0 ? 1 : size)) return ptr;
+
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
+
+// Once every buffer grew to the size a frame needs, drawing and writing frames of the same size don't allocate anymore
+int AllocationTest(int, char*[]) {
+    CHECK(FakeTerminal(40, 10));
+
+    {
+        Window window(2, 1, 30, 6);
+        OutputBuffer out(-1);
+        StyleId state = NO_STYLE;
+
+        const char* frames[] = {"frame one", "second fr\xc3\xa4me", "third"};
+        std::vector<WindowSpan> spans(6);
+
+        for(uint64_t frame = 0; frame < 12; frame++) {
+            if(frame == 6) allocations = 0;
+
+            // Every line is written and serialized again each frame
+            for(uint64_t line = 0; line < 6; line++) {
+                spans[line] = WindowSpan{line, line, frames[(frame + line) % 3], STANDARD_STYLE};
+            }
+
+            window.Write(spans);
+
+            window.Draw(state, true, out);
+            out.Clear();
+        }
+
+        CHECK(allocations == 0);
+    }
+
+    {
+        StyledString str(std::string(40, '.'));
+
+        std::vector<StyledSpan> spans = {{2, "ab", 0}, {8, "\xc3\xa9t\xc3\xa9", 0}, {20, "wide\xe7\x95\x8c", 0}, {36, "cut off", 0}};
+        std::vector<uint64_t> starts = {2, 8, 20, 36};
+
+        Style red("");
+        red.FG(Color(255, 0, 0));
+
+        StyleId styles[] = {STANDARD_STYLE, style_allocator.Intern(red)};
+
+        for(uint64_t frame = 0; frame < 12; frame++) {
+            if(frame == 6) allocations = 0;
+
+            // The spans move and change their style, so segments are split and merged every frame
+            for(uint64_t i = 0; i < spans.size(); i++) {
+                spans[i].index = starts[i] + frame % 3;
+                spans[i].style = styles[(frame + i) % 2];
+            }
+
+            str.Write(spans);
+        }
+
+        CHECK(allocations == 0);
+
+        style_allocator.Release(styles[1]);
+    }
+
+    return 0;
+}
@@ -0,0 +1,78 @@
+#include "Window.h"
+
+#include "Test.h"
+
+using namespace LibTesix;
+
+// An overlay of the given size with text at col, line
+static Overlay Mark(uint64_t width, uint64_t height, uint64_t col, uint64_t line, const char* text) {
+    Overlay overlay(width, height);
+    overlay.lines[line].Add(text, STANDARD_STYLE, col);
+
+    return overlay;
+}
+
+int LayerTest(int, char*[]) {
+    CHECK(FakeTerminal(10, 6));
+
+    {
+        // Layers stay at their rows while the lines scroll below them, even though the window spans the whole terminal width
+        VirtualTerminal terminal(10, 6);
+        Window window(0, 0, 10, 4);
+
+        window.Write(0, 0, "a", STANDARD_STYLE);
+        window.Write(0, 1, "b", STANDARD_STYLE);
+        window.Write(0, 2, "c", STANDARD_STYLE);
+        window.Write(0, 3, "d", STANDARD_STYLE);
+        window.AddLayer(Mark(10, 4, 5, 1, "#"));
+
+        Draw(window, terminal);
+
+        CHECK(terminal.Row(0) == "a");
+        CHECK(terminal.Row(1) == "b    #");
+
+        window.Scroll(1);
+        Draw(window, terminal);
+
+        CHECK(terminal.Row(0) == "b");
+        CHECK(terminal.Row(1) == "c    #");
+        CHECK(terminal.Row(2) == "d");
+        CHECK(terminal.Row(3) == "");
+
+        window.Scroll(-2);
+        Draw(window, terminal);
+
+        CHECK(terminal.Row(0) == "");
+        CHECK(terminal.Row(1) == "     #");
+        CHECK(terminal.Row(2) == "b");
+        CHECK(terminal.Row(3) == "c");
+    }
+
+    {
+        // Layers with the same z are drawn in the order they were added, also after their z was changed
+        VirtualTerminal terminal(10, 6);
+        Window window(0, 0, 10, 1);
+
+        uint64_t a = window.AddLayer(Mark(10, 1, 2, 0, "A"));
+        window.AddLayer(Mark(10, 1, 2, 0, "B"));
+
+        Draw(window, terminal);
+        CHECK(terminal.Row(0) == "  B");
+
+        window.SetLayerZ(a, 1);
+        Draw(window, terminal);
+        CHECK(terminal.Row(0) == "  A");
+
+        window.SetLayerZ(a, 0);
+        Draw(window, terminal);
+        CHECK(terminal.Row(0) == "  B");
+
+        // The overlay is added last, so it is drawn above the other layers at z 0
+        Overlay overlay = Mark(10, 1, 2, 0, "O");
+        window.ApplyOverlay(overlay);
+        Draw(window, terminal);
+        CHECK(terminal.Row(0) == "  O");
+    }
+
+    return 0;
+}
@@ -0,0 +1,89 @@
+#include "Output.h"
+#include "Scene.h"
+#include "Window.h"
+
+#include "Test.h"
+
+#include <memory>
+
+using namespace LibTesix;
+
+int OutputTest(int, char*[]) {
+    CHECK(FakeTerminal(20, 5));
+
+    {
+        // Referenced bytes are copied once who owns them asks for it
+        OutputBuffer out(-1);
+        std::string owned = "referenced";
+
+        out.Append("a");
+        out.AppendRef(owned);
+        out.Append('b');
+        out.CopyReferences();
+
+        owned = "changed";
+
+        CHECK(std::string(out.Data(), out.Size()) == "areferencedb");
+    }
+
+    {
+        // The output a window was drawn to can be destroyed before the window is changed or destroyed
+        auto window = std::make_unique<Window>(0, 0, 10, 2);
+        window->Write(0, 0, "text", STANDARD_STYLE);
+
+        StyleId state = NO_STYLE;
+
+        {
+            OutputBuffer out(-1);
+            window->Draw(state, true, out);
+        }
+
+        window->Write(0, 1, "more", STANDARD_STYLE);
+        window->Resize(12, 3);
+
+        {
+            OutputBuffer out(-1);
+            window->Draw(state, true, out);
+        }
+
+        window.reset();
+    }
+
+    {
+        // A line drawn again in the same frame keeps what it was drawn as first, lines that aren't serialized again stay referenced
+        Window window(0, 0, 10, 2);
+        window.Write(0, 0, "first", STANDARD_STYLE);
+        window.Write(0, 1, "other", STANDARD_STYLE);
+
+        OutputBuffer out(-1);
+        StyleId state = NO_STYLE;
+
+        window.DrawLine(0, 0, 10, state, out);
+        window.DrawLine(1, 0, 10, state, out);
+        window.Write(0, 0, "second", STANDARD_STYLE);
+        window.DrawLine(0, 0, 10, state, out);
+
+        std::string bytes(out.Data(), out.Size());
+
+        CHECK(bytes.find("first") != std::string::npos);
+        CHECK(bytes.find("other") != std::string::npos);
+        CHECK(bytes.find("second") != std::string::npos);
+        CHECK(bytes.find("first") < bytes.find("other") && bytes.find("other") < bytes.find("second"));
+    }
+
+    {
+        Scene scene;
+        uint64_t id = scene.AddWindow(Window(1, 1, 5, 2));
+
+        StyleId state = NO_STYLE;
+
+        {
+            OutputBuffer out(-1);
+            scene.Draw(state, out);
+        }
+
+        scene.RemoveWindow(id);
+    }
+
+    return 0;
+}
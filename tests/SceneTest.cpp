@@ -0,0 +1,100 @@
+#include "Scene.h"
+
+#include "Test.h"
+
+using namespace LibTesix;
+
+// A window with every cell set to c
+static Window Filled(int64_t x, int64_t y, uint64_t width, uint64_t height, char c) {
+    Window window(x, y, width, height);
+
+    for(uint64_t line = 0; line < height; line++) {
+        window.Write(0, line, std::string(width, c), STANDARD_STYLE);
+    }
+
+    return window;
+}
+
+// Draws what changed in scene since its last Draw into terminal
+static void Draw(Scene& scene, StyleId& state, VirtualTerminal& terminal) {
+    OutputBuffer out(-1);
+
+    scene.Draw(state, out);
+    terminal.Feed(std::string_view(out.Data(), out.Size()));
+
+    out.Clear();
+}
+
+static bool Rows(const VirtualTerminal& terminal, const std::vector<std::string>& rows) {
+    for(uint64_t i = 0; i < rows.size(); i++) {
+        if(terminal.Row(i) != rows[i]) {
+            std::fprintf(stderr, "row %lu: \"%s\" instead of \"%s\"\n", i, terminal.Row(i).c_str(), rows[i].c_str());
+            return false;
+        }
+    }
+
+    return true;
+}
+
+int SceneTest(int, char*[]) {
+    CHECK(FakeTerminal(12, 5));
+
+    VirtualTerminal terminal(12, 5);
+    StyleId state = NO_STYLE;
+
+    Scene scene;
+
+    // Windows with the same z are stacked in the order they were added
+    uint64_t a = scene.AddWindow(Filled(0, 0, 6, 3, 'a'));
+    uint64_t b = scene.AddWindow(Filled(3, 1, 6, 3, 'b'));
+
+    Draw(scene, state, terminal);
+    CHECK(Rows(terminal, {"aaaaaa", "aaabbbbbb", "aaabbbbbb", "   bbbbbb", ""}));
+
+    // Changes to covered cells stay hidden, the rest is drawn
+    scene.GetWindow(a).Write(0, 0, "x", STANDARD_STYLE);
+    scene.GetWindow(a).Write(4, 1, "x", STANDARD_STYLE);
+
+    Draw(scene, state, terminal);
+    CHECK(Rows(terminal, {"xaaaaa", "aaabbbbbb", "aaabbbbbb", "   bbbbbb", ""}));
+
+    // Raising a window uncovers what it was below
+    scene.SetZ(a, 1);
+
+    Draw(scene, state, terminal);
+    CHECK(Rows(terminal, {"xaaaaa", "aaaaxabbb", "aaaaaabbb", "   bbbbbb", ""}));
+
+    // Lowering it back to the same z puts it below the window added after it again
+    scene.SetZ(a, 0);
+
+    Draw(scene, state, terminal);
+    CHECK(Rows(terminal, {"xaaaaa", "aaabbbbbb", "aaabbbbbb", "   bbbbbb", ""}));
+
+    // Moving a window draws what it left behind
+    scene.GetWindow(b).Move(6, 2);
+
+    Draw(scene, state, terminal);
+    CHECK(Rows(terminal, {"xaaaaa", "aaaaxa", "aaaaaabbbbbb", "      bbbbbb", "      bbbbbb"}));
+
+    // Removed windows are replaced by the background
+    scene.RemoveWindow(a);
+
+    Draw(scene, state, terminal);
+    CHECK(Rows(terminal, {"", "", "      bbbbbb", "      bbbbbb", "      bbbbbb"}));
+
+    // Nothing is drawn once nothing changed
+    {
+        OutputBuffer out(-1);
+
+        scene.Draw(state, out);
+        CHECK(out.Size() == 0);
+    }
+
+    // A window partly off the terminal is clipped
+    scene.AddWindow(Filled(-2, -1, 5, 3, 'c'), 2);
+
+    Draw(scene, state, terminal);
+    CHECK(Rows(terminal, {"ccc", "ccc", "      bbbbbb", "      bbbbbb", "      bbbbbb"}));
+
+    return 0;
+}
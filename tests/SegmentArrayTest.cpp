@@ -0,0 +1,172 @@
+#include "StyledString.h"
+
+#include "Test.h"
+
+#include <random>
+
+using namespace LibTesix;
+
+// Exposes the segment lookup
+struct ProbedString : public StyledString {
+    using StyledSegmentArray::GetSegmentIndex;
+};
+
+// What a single column of a string holds
+struct ModelCell {
+    std::string glyph;
+    StyleId style;
+
+    bool operator==(const ModelCell& other) const = default;
+};
+
+// Lists every column of str, columns that aren't covered by any segment are left empty
+static std::vector<ModelCell> Columns(const StyledString& str) {
+    std::vector<ModelCell> columns(str.Len(), ModelCell{"", NO_STYLE});
+
+    for(uint64_t i = 0; i < str.SegmentCount(); i++) {
+        StyledSegmentView segment = str.Segment(i);
+        uint64_t start = str.Start(i);
+
+        for(uint64_t col = 0; col < segment.Len() && start + col < columns.size(); col++) {
+            uint64_t next = segment.NextCluster(col);
+            columns[start + col] = ModelCell{std::string(segment.Str().substr(segment.Offset(col), segment.Offset(next) - segment.Offset(col))),
+                segment.style};
+        }
+    }
+
+    return columns;
+}
+
+// Whether the segments are sorted and don't overlap
+static bool Ordered(const StyledString& str) {
+    for(uint64_t i = 0; i + 1 < str.SegmentCount(); i++) {
+        if(str.Start(i) + str.Segment(i).Len() > str.Start(i + 1)) return false;
+    }
+
+    return str.SegmentCount() == 0 || str.Start(str.SegmentCount() - 1) + str.Segment(str.SegmentCount() - 1).Len() == str.Len();
+}
+
+// Whether every column is found in the segment that covers it
+static bool Lookup(const ProbedString& str) {
+    for(uint64_t i = 0; i < str.SegmentCount(); i++) {
+        for(uint64_t col = str.Start(i); col < str.Start(i) + str.Segment(i).Len(); col++) {
+            if(str.GetSegmentIndex(col) != i) return false;
+        }
+    }
+
+    return true;
+}
+
+// The number of runs of columns with the same style
+static uint64_t StyleRuns(const std::vector<ModelCell>& model) {
+    uint64_t runs = 0;
+
+    for(uint64_t i = 0; i < model.size(); i++) {
+        if(i == 0 || model[i].style != model[i - 1].style) runs++;
+    }
+
+    return runs;
+}
+
+// Applies random edits to a string and to a plain vector of columns and compares them after every edit
+int SegmentArrayTest(int, char*[]) {
+    const std::vector<std::string> glyphs = {"a", "b", "c", "\xc3\xa9", "x"};
+
+    std::mt19937 rng(1);
+
+    for(int iteration = 0; iteration < 500; iteration++) {
+        ProbedString str;
+        std::vector<ModelCell> model;
+
+        for(int step = 0; step < 60; step++) {
+            uint64_t len = 1 + rng() % 5;
+            StyleId style = rng() % 3;
+
+            std::string text;
+            std::vector<ModelCell> cells;
+
+            for(uint64_t i = 0; i < len; i++) {
+                const std::string& glyph = glyphs[rng() % glyphs.size()];
+
+                text += glyph;
+                cells.push_back(ModelCell{glyph, style});
+            }
+
+            int edit = rng() % 7;
+
+            if(edit <= 1 || model.empty()) {
+                uint64_t index = rng() % (model.size() + 1);
+
+                str.Insert(text, style, index);
+                model.insert(model.begin() + index, cells.begin(), cells.end());
+            } else if(edit == 2) {
+                uint64_t index = rng() % model.size();
+
+                str.Write(text, style, index);
+
+                for(uint64_t i = 0; i < len && index + i < model.size(); i++) {
+                    model[index + i] = cells[i];
+                }
+            } else if(edit == 3) {
+                uint64_t start = rng() % model.size();
+                uint64_t end = rng() % model.size();
+                if(start > end) std::swap(start, end);
+
+                // The string is kept non-empty, so the other edits always have a column to work on
+                if(end - start + 1 == model.size()) continue;
+
+                str.Erase(start, end);
+                model.erase(model.begin() + start, model.begin() + end + 1);
+            } else if(edit == 4) {
+                uint64_t start = rng() % model.size();
+                uint64_t end = rng() % model.size();
+                if(start > end) std::swap(start, end);
+
+                StyleRange range{start, end, style};
+                str.Restyle(std::span<const StyleRange>(&range, 1));
+
+                for(uint64_t i = start; i <= end; i++) {
+                    model[i].style = style;
+                }
+            } else if(edit == 5) {
+                str.Compact();
+
+                // Every run of a style is a single segment
+                CHECK(str.SegmentCount() == StyleRuns(model));
+            } else {
+                std::vector<StyledSpan> spans;
+                std::vector<std::string> texts;
+                texts.reserve(4);
+
+                uint64_t index = rng() % model.size();
+
+                while(index < model.size() && spans.size() < 4) {
+                    StyleId span_style = rng() % 3;
+                    uint64_t span_len = 1 + rng() % 3;
+
+                    std::string span_text;
+
+                    for(uint64_t i = 0; i < span_len; i++) {
+                        const std::string& glyph = glyphs[rng() % glyphs.size()];
+
+                        span_text += glyph;
+                        if(index + i < model.size()) model[index + i] = ModelCell{glyph, span_style};
+                    }
+
+                    texts.push_back(span_text);
+                    spans.push_back(StyledSpan{index, texts.back(), span_style});
+
+                    index += span_len + rng() % 3;
+                }
+
+                str.Write(std::span<const StyledSpan>(spans));
+            }
+
+            CHECK(Ordered(str));
+            CHECK(Columns(str) == model);
+            CHECK(Lookup(str));
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,135 @@
+#include "Screen.h"
+#include "Style.h"
+#include "StyledString.h"
+
+#include "Test.h"
+
+using namespace LibTesix;
+
+int StyleTest(int, char*[]) {
+    Style red("");
+    red.FG(Color(255, 0, 0));
+
+    Style green("");
+    green.FG(Color(0, 255, 0));
+
+    Style blue("");
+    blue.FG(Color(0, 0, 255));
+
+    // Interning the same look twice returns the same id
+    StyleId red_id = style_allocator.Intern(red);
+    CHECK(style_allocator.Intern(red) == red_id);
+
+    const Style* red_style = style_allocator[red_id];
+
+    // Pointers stay valid while styles are added
+    for(int i = 0; i < 64; i++) {
+        style_allocator.Add(Style("filler" + std::to_string(i)));
+    }
+
+    CHECK(style_allocator[red_id] == red_style);
+
+    // The id is kept as long as a reference is left
+    style_allocator.Release(red_id);
+    CHECK(style_allocator[red_id] != nullptr);
+
+    StyleId green_id = style_allocator.Intern(green);
+    CHECK(green_id != red_id);
+
+    // Once the last reference is released the slot is reused by the next interned style, under a new id
+    style_allocator.Release(red_id);
+    CHECK(style_allocator[red_id] == nullptr);
+
+    uint64_t generation = style_allocator.Generation();
+
+    StyleId blue_id = style_allocator.Intern(blue);
+    CHECK(blue_id != red_id);
+    CHECK(style_allocator[red_id] == nullptr);
+    CHECK(style_allocator[blue_id] == red_style);
+    CHECK(style_allocator[blue_id]->col.fg == Color(0, 0, 255));
+
+    // Reuse doesn't make everything redraw
+    CHECK(style_allocator.Generation() == generation);
+
+    // The escape codes cached for the freed style aren't reused
+    CHECK(style_allocator.Transition(NO_STYLE, blue_id).find("38;2;0;0;255") != std::string_view::npos);
+    CHECK(style_allocator.Transition(red_id, blue_id).find("38;2;0;0;255") != std::string_view::npos);
+
+    // Retained ids aren't freed by a single release
+    style_allocator.Retain(green_id);
+    style_allocator.Release(green_id);
+    CHECK(style_allocator[green_id] != nullptr);
+    CHECK(style_allocator.Intern(green) == green_id);
+
+    // A terminal state still naming a freed style is reset to the new one
+    {
+        Style bold("");
+        bold.FG(Color(0, 0, 255))->Bold(true);
+
+        StyleId x_id = style_allocator.Intern(red);
+
+        int fds[2];
+        CHECK(pipe(fds) == 0);
+
+        Screen screen(1, 1);
+        OutputBuffer out(fds[1]);
+        StyleId screen_state = NO_STYLE;
+
+        screen.Write(0, 0, StyledString("X", x_id));
+        screen.Flush(screen_state, out);
+        CHECK(screen_state == x_id);
+
+        style_allocator.Release(x_id);
+
+        StyleId reused_id = style_allocator.Intern(blue);
+        StyleId bold_id = style_allocator.Intern(bold);
+
+        char bytes[256];
+        CHECK(read(fds[0], bytes, sizeof(bytes)) > 0);
+
+        screen.Write(0, 0, StyledString("Y", bold_id));
+        screen.Flush(screen_state, out);
+
+        int64_t len = read(fds[0], bytes, sizeof(bytes));
+        CHECK(len > 0);
+        CHECK(std::string_view(bytes, len).find("38;2;0;0;255") != std::string_view::npos);
+
+        close(fds[0]);
+        close(fds[1]);
+
+        style_allocator.Release(reused_id);
+        style_allocator.Release(bold_id);
+    }
+
+    // The transition cache stays bounded and still returns the right codes once it was emptied
+    {
+        StyleId from = style_allocator.Intern(red);
+        std::vector<StyleId> shades;
+
+        for(uint8_t i = 0; i < 255; i++) {
+            Style shade("");
+            shade.FG(Color(i, 1, 2));
+            shades.push_back(style_allocator.Intern(shade));
+        }
+
+        // More pairs than the cache holds
+        for(uint64_t step = 1; step <= 20; step++) {
+            for(uint64_t i = 0; i < shades.size(); i++) {
+                style_allocator.Transition(shades[i], shades[(i + step) % shades.size()]);
+            }
+        }
+
+        style_allocator.Transition(shades[3], from);
+
+        CHECK(style_allocator.Transition(from, shades[7]).find("38;2;7;1;2") != std::string_view::npos);
+        CHECK(style_allocator.Transition(shades[7], from).find("38;2;255;0;0") != std::string_view::npos);
+
+        for(StyleId shade : shades) {
+            style_allocator.Release(shade);
+        }
+
+        style_allocator.Release(from);
+    }
+
+    return 0;
+}
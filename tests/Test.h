@@ -0,0 +1,150 @@
+#pragma once
+
+#include "Window.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <string>
+#include <string_view>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#include <vector>
+
+// Fails the test function it is used in if condition doesn't hold
+#define CHECK(condition)                                                                       \
+    do {                                                                                       \
+        if(!(condition)) {                                                                     \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+            return 1;                                                                          \
+        }                                                                                      \
+    } while(false)
+
+// Makes stdout a pseudo terminal of the given size, the library only sees a terminal size if stdout is one
+// Nothing is read from the terminal, so the tests mustn't write to stdout afterwards
+inline bool FakeTerminal(uint16_t width, uint16_t height) {
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+
+    if(master < 0 || grantpt(master) != 0 || unlockpt(master) != 0) return false;
+
+    int slave = open(ptsname(master), O_RDWR | O_NOCTTY);
+
+    if(slave < 0) return false;
+
+    struct winsize size {};
+    size.ws_col = width;
+    size.ws_row = height;
+
+    return ioctl(slave, TIOCSWINSZ, &size) == 0 && dup2(slave, STDOUT_FILENO) >= 0;
+}
+
+// Keeps the text a terminal would display after being sent the output of the library, styles are ignored
+// Understands the cursor movements, scroll regions and scrolls the library uses
+class VirtualTerminal {
+  public:
+    VirtualTerminal(uint64_t width, uint64_t height) 
+        : width(width), height(height), cells(height, std::vector<std::string>(width, " ")), bottom(height) {
+    }
+
+    void Feed(std::string_view bytes) {
+        for(uint64_t i = 0; i < bytes.size();) {
+            if(bytes[i] == '\033' && i + 1 < bytes.size() && bytes[i + 1] == '[') {
+                i = Csi(bytes, i + 2);
+                continue;
+            }
+
+            // A whole UTF-8 character goes into the cell
+            uint64_t len = 1;
+            while(i + len < bytes.size() && (bytes[i + len] & 0xC0) == 0x80) {
+                len++;
+            }
+
+            if(row < height && col < width) cells[row][col] = std::string(bytes.substr(i, len));
+            col++;
+
+            i += len;
+        }
+    }
+
+    // The text of a row without trailing spaces
+    std::string Row(uint64_t row) const {
+        std::string text;
+
+        for(const std::string& cell : cells[row]) {
+            text += cell;
+        }
+
+        return text.substr(0, text.find_last_not_of(' ') + 1);
+    }
+
+  private:
+    // Handles the control sequence starting at i, returns the index after it
+    uint64_t Csi(std::string_view bytes, uint64_t i) {
+        std::vector<int64_t> params(1, 0);
+        bool set = false;
+
+        for(; i < bytes.size(); i++) {
+            char c = bytes[i];
+
+            if(c >= '0' && c <= '9') {
+                params.back() = params.back() * 10 + (c - '0');
+                set = true;
+            } else if(c == ';') {
+                params.push_back(0);
+            } else {
+                int64_t n = set && params[0] > 0 ? params[0] : 1;
+
+                if(c == 'f' || c == 'H') {
+                    row = (params[0] > 0 ? params[0] : 1) - 1;
+                    col = (params.size() > 1 && params[1] > 0 ? params[1] : 1) - 1;
+                } else if(c == 'C') {
+                    col += n;
+                } else if(c == 'r') {
+                    top = set && params[0] > 0 ? params[0] - 1 : 0;
+                    bottom = params.size() > 1 && params[1] > 0 ? params[1] : height;
+                } else if(c == 'S') {
+                    for(int64_t s = 0; s < n; s++) {
+                        cells.erase(cells.begin() + top);
+                        cells.insert(cells.begin() + bottom - 1, std::vector<std::string>(width, " "));
+                    }
+                } else if(c == 'T') {
+                    for(int64_t s = 0; s < n; s++) {
+                        cells.erase(cells.begin() + bottom - 1);
+                        cells.insert(cells.begin() + top, std::vector<std::string>(width, " "));
+                    }
+                } else if(c == 'J') {
+                    cells.assign(height, std::vector<std::string>(width, " "));
+                }
+
+                return i + 1;
+            }
+        }
+
+        return i;
+    }
+
+    uint64_t width;
+    uint64_t height;
+
+    std::vector<std::vector<std::string>> cells;
+
+    uint64_t row = 0;
+    uint64_t col = 0;
+
+    // The scroll region from top to bottom (exclusive)
+    uint64_t top = 0;
+    uint64_t bottom;
+};
+
+// Draws window and feeds the bytes it sends to the terminal into terminal
+// The frame is ended before the buffer is destroyed, the window only ever holds a handle to it
+inline void Draw(LibTesix::Window& window, VirtualTerminal& terminal) {
+    LibTesix::OutputBuffer out(-1);
+    LibTesix::StyleId state = LibTesix::NO_STYLE;
+
+    window.Draw(state, true, out);
+    terminal.Feed(std::string_view(out.Data(), out.Size()));
+
+    out.Clear();
+}
@@ -0,0 +1,74 @@
+#include "Window.h"
+
+#include "Test.h"
+
+using namespace LibTesix;
+
+int WindowTest(int, char*[]) {
+    CHECK(FakeTerminal(40, 10));
+
+    VirtualTerminal terminal(40, 10);
+    Window window(2, 1, 20, 3);
+
+    // Format writes like Write and reuses its buffer
+    window.Format(1, 0, STANDARD_STYLE, "{}: {:03}", "score", 7);
+    window.Format(1, 1, STANDARD_STYLE, "{:.2f}|{:>4}", 1.5, "ab");
+
+    Draw(window, terminal);
+
+    CHECK(terminal.Row(1) == "   score: 007");
+    CHECK(terminal.Row(2) == "   1.50|  ab");
+
+    // Text that doesn't fit continues on the next line like with Write
+    window.Format(15, 1, STANDARD_STYLE, "{}", "overflow");
+
+    Draw(window, terminal);
+
+    CHECK(terminal.Row(2) == "   1.50|  ab     overf");
+    CHECK(terminal.Row(3) == "  low");
+
+    {
+        // A window spanning the whole width is scrolled by the terminal, only the exposed line is drawn again
+        VirtualTerminal scrolled(40, 10);
+        Window full(0, 1, 40, 4);
+
+        full.Write(0, 0, "one", STANDARD_STYLE);
+        full.Write(0, 1, "two", STANDARD_STYLE);
+        full.Write(0, 2, "three", STANDARD_STYLE);
+        full.Write(0, 3, "four", STANDARD_STYLE);
+
+        Draw(full, scrolled);
+
+        full.Scroll(1);
+        full.Write(0, 3, "five", STANDARD_STYLE);
+
+        OutputBuffer out(-1);
+        StyleId state = NO_STYLE;
+
+        full.Draw(state, true, out);
+
+        std::string bytes(out.Data(), out.Size());
+        scrolled.Feed(bytes);
+
+        CHECK(bytes.find("\033[2;5r\033[1S\033[r") != std::string::npos);
+        CHECK(bytes.find("two") == std::string::npos);
+
+        CHECK(scrolled.Row(1) == "two");
+        CHECK(scrolled.Row(2) == "three");
+        CHECK(scrolled.Row(3) == "four");
+        CHECK(scrolled.Row(4) == "five");
+
+        // Scrolling down exposes the top line
+        full.Scroll(-2);
+        full.Write(0, 0, "zero", STANDARD_STYLE);
+
+        Draw(full, scrolled);
+
+        CHECK(scrolled.Row(1) == "zero");
+        CHECK(scrolled.Row(2) == "");
+        CHECK(scrolled.Row(3) == "two");
+        CHECK(scrolled.Row(4) == "three");
+    }
+
+    return 0;
+}